@@ -6,6 +6,37 @@
 #include <sstream>
 #include <stdexcept>
 #include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <climits>
+#include <cstdint>
+#include <bitset>
+#include <iterator>
+#include <unordered_map>
+#include <unordered_set>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <exception>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <cerrno>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
 
 /**
    @brief The CmdLineArgs class implements the command line parsing.
@@ -13,7 +44,44 @@
 class CmdLineArgs {
 public:
 
+    /// The kinds of parsing errors.
+    enum class ErrorCode : unsigned char {
+        MissingValue,       ///< A parameter is not followed by a value.
+        IncorrectValue,     ///< The value of a parameter cannot be converted.
+        WrongNbValues,      ///< A parameter with multiple values does not have the expected number of values.
+        Remaining,          ///< There are remaining arguments.
+        Unparsed,           ///< There are unparsed options.
+        UnterminatedQuote,  ///< A quote is not closed in a command line.
+        OutOfRange,         ///< The value of a parameter is out of its range.
+        InvalidChoice,      ///< The value of a parameter is not one of its choices.
+        Exclusive,          ///< Two mutually exclusive options are present.
+        MissingRequired,    ///< An option is present without an option it requires.
+        DuplicateKey        ///< A key is given twice to a map parameter refusing duplicates.
+    };
+
+    /// A parsing error. The message is only built when asked with errorMessage().
+    struct Error {
+        ErrorCode code;
+        int option;         ///< Index of the option in definition order, or of the argument for Remaining and Unparsed,
+                            ///< or of the quote in the command line for UnterminatedQuote.
+        unsigned nb_expected;    ///< The expected number of values for WrongNbValues.
+        int other;          ///< The other option for Exclusive and MissingRequired.
+    };
+
     CmdLineArgs(int argc, char** argv, const std::string &usage_intro, bool allow_set_with_equal=true);
+    CmdLineArgs(const std::string &cmd_line, const std::string &usage_intro, bool allow_set_with_equal=true);
+
+    // To parse new arguments, keeping the options defined by the previous parsing:
+    void reset(int argc, char** argv);
+    void reset(const std::string &cmd_line);
+
+    // To split a command line into arguments, following the shell quoting rules:
+    static std::vector<std::string> tokenize(const std::string &cmd_line);
+
+    // To parse in parallel a stream of command lines with the same options:
+    struct BatchErrors;
+    template <class Columns> static std::size_t parseBatch(std::istream &in, Columns &columns,
+                                                           unsigned nb_threads=0, std::size_t chunk_size=4096);
 
     // Get parameters (with or without a short name):
     template <class T> T getParam(const std::string &long_name, char short_name, T default_value, const std::string &desc);
@@ -22,10 +90,34 @@ public:
     // Get multiple values in a vector: (with or without a short name)
     template <class T> std::vector<T> getParams(const std::string &long_name, char short_name,
                                                 const std::vector<T> &default_vals, bool enforce_default_size,
-                                                const std::string &desc, char separator=',');
+                                                const std::string &desc, char separator=',', bool accumulate=false);
     template <class T> std::vector<T> getParams(const std::string &long_name,
                                                 const std::vector<T> &default_vals, bool enforce_default_size,
-                                                const std::string &desc, char separator=',');
+                                                const std::string &desc, char separator=',', bool accumulate=false);
+
+    // Get the values of all the occurrences of a parameter: (with or without a short name)
+    template <class T> std::vector<T> getAllParams(const std::string &long_name, char short_name,
+                                                   const std::string &desc, char separator='\0');
+    template <class T> std::vector<T> getAllParams(const std::string &long_name,
+                                                   const std::string &desc, char separator='\0');
+
+    // Get parameters converted only when used: (with or without a short name)
+    template <class T> class Lazy;
+    template <class T> Lazy<T> getLazyParam(const std::string &long_name, char short_name, T default_value, const std::string &desc);
+    template <class T> Lazy<T> getLazyParam(const std::string &long_name,                  T default_value, const std::string &desc);
+    Lazy<std::string> getLazyParam(const std::string &long_name, char short_name, const char* default_value, const std::string &desc);
+    Lazy<std::string> getLazyParam(const std::string &long_name,                  const char* default_value, const std::string &desc);
+    void convertEagerly(bool eager=true);
+
+    // Get paths, probed in the background while the parsing goes on: (with or without a short name)
+    struct PathInfo;
+    enum Probe : unsigned { ProbeStat = 1, ProbeOpen = 2, ProbeReadahead = 4 };
+    std::shared_future<PathInfo> getPath(const std::string &long_name, char short_name, const std::string &default_value,
+                                         const std::string &desc, unsigned probes=ProbeStat);
+    std::shared_future<PathInfo> getPath(const std::string &long_name, const std::string &default_value,
+                                         const std::string &desc, unsigned probes=ProbeStat);
+    std::vector<std::shared_future<PathInfo> > probeRemaining(unsigned probes=ProbeStat);
+    static PathInfo probePath(const std::string &path, unsigned probes=ProbeStat);
 
     // Get a flag (with or without a short name):
     int getFlag(const std::string &long_name, char short_name, const std::string &desc);
@@ -41,10 +133,10 @@ public:
     // String specialisation for multiple values:
     std::vector<std::string> getParams(const std::string &long_name, char short_name,
                                        const std::vector<std::string> &default_vals, bool enforce_default_size,
-                                       const std::string &desc, char separator=',');
+                                       const std::string &desc, char separator=',', bool accumulate=false);
     std::vector<std::string> getParams(const std::string &long_name,
                                        const std::vector<std::string> &default_vals, bool enforce_default_size,
-                                       const std::string &desc, char separator=',');
+                                       const std::string &desc, char separator=',', bool accumulate=false);
     /// @endcond
 
     // To format the usage, adding a separation between options:
@@ -54,7 +146,12 @@ public:
     void addUsageOutro(const std::string &str);
 
     // To get the nicely formatted usage:
-    std::string usage();
+    const std::string& usage();
+    void usage(std::ostream &os);
+
+    // To wrap the descriptions of the usage to a given width: (0 means no wrapping)
+    void setUsageWidth(int width);
+    static int terminalWidth();
 
     // Get the remaining and unparsed arguments:
     std::vector<std::string> getRemaining();
@@ -67,16 +164,421 @@ public:
     // To check if a parameter or flag is present, without retriving it:
     bool isPresent(const std::string &long_name,  char short_name=' ');
 
+    // To check if a parameter or flag was present, once retrieved:
+    bool wasPresent(const std::string &long_name) const;
+
+    // To look up the parsed values by option index, through the overrides of the current thread:
+    class ScopedOverride;
+    int optionId(const std::string &long_name) const;
+    bool wasPresent(int id) const;
+    const std::string& rawValue(int id) const;
+    template <class T> T value(int id, T default_value) const;
+    std::string value(int id, const char *default_value) const;
+
+    // To add constraints on the options, and to check them once all the options are retrieved:
+    void addRange(const std::string &long_name, double min, double max);
+    void addChoices(const std::string &long_name, const std::vector<std::string> &choices);
+    void addExclusive(const std::vector<std::string> &long_names);
+    void addRequires(const std::string &long_name, const std::string &required);
+    void checkConstraints();
+
+    // A set of integers given as ranges, to be used as a parameter type:
+    class RangeSet;
+
+    // Get key=value pairs in a map: (with or without a short name)
+    class Map;
+    enum class Duplicates : unsigned char { KeepLast, KeepFirst, Refuse };
+    Map getMap(const std::string &long_name, char short_name, const std::string &desc,
+               Duplicates duplicates=Duplicates::KeepLast, char separator=',');
+    Map getMap(const std::string &long_name, const std::string &desc,
+               Duplicates duplicates=Duplicates::KeepLast, char separator=',');
+
+    // To share the result of the parsing with other processes:
+    class Snapshot;
+    std::string snapshot() const;
+    int snapshotFd() const;
+
+    // To collect the errors instead of throwing at the first one:
+    void collectErrors(bool collect=true);
+    const std::vector<Error>& errors() const;
+    std::string errorMessage(const Error &error) const;
+    void throwIfErrors() const;
+
 private:
 
+    struct Option {
+        std::string long_name;
+        char short_name;
+        int count;              // Number of times the option was found
+        std::string value;      // Value of a parameter, as given on the command line
+        char separator;         // The separator of the values in value, or '\0' for a single value
+    };
+
+    struct Constraint {
+        ErrorCode error;                        // The error when the constraint is not met
+        std::vector<std::string> names;         // The options concerned
+        double min, max;
+        std::vector<std::string> choices;
+        std::unordered_set<std::string> choices_set;
+    };
+
     std::vector<std::string> args_;
+    std::vector<Option> options_;
+    std::unordered_map<std::string, int> ids_;  // Index of the options by long name
+    std::vector<uint64_t> present_;             // Bit set of the options found
+    std::vector<Constraint> constraints_;
+    class ProbePool;
+    std::shared_ptr<ProbePool> probe_pool_;
+    std::vector<Error> errors_;
+    bool collect_errors_ = false;
+    bool eager_ = false;
+    bool allow_set_with_equal_;
+    bool compiled_ = false;
+    unsigned next_option_ = 0;
+    std::string token_;
     std::string usage_intro_, usage_outro_;
     std::vector<std::pair<std::string, std::string> > usage_;
+    std::string usage_cache_;
+    bool usage_valid_ = false;
+    std::string::size_type usage_width_ = 0;
 
     static std::vector<std::string> split(const std::string &s, char delim);
-    void addUsage(const std::string &long_name, char short_name, const std::string &default_val, const std::string &desc);
+    template <class F> static std::string::size_type tokenize(const std::string &cmd_line, std::string &token, F add);
+    void pushArg(const char *arg, std::string::size_type size);
+    void parseCmdLine(const std::string &cmd_line);
+    void rewind();
+    int nextDefinedOption(const std::string &long_name);
+    void renderUsage(std::string &out) const;
+    void appendWrapped(std::string &out, const std::string &desc, std::string::size_type left_size) const;
+    int addUsage(const std::string &long_name, char short_name, const std::string &default_val, const std::string &desc);
+    static bool isLongName(const std::string &arg, const std::string &name);
+    static bool hasShortName(const std::string &arg, char name);
     std::vector<std::string>::iterator findLongName(const std::string &name);
     std::vector<std::string>::iterator findShortName(char);
+    std::vector<std::string>::iterator findValue(int id);
+    void fail(ErrorCode code, int option, unsigned nb_expected=0, int other=-1);
+    void setPresent(int id);
+    bool isSet(int id) const;
+    int findId(const std::string &long_name) const;
+    bool checkValue(const Constraint &constraint, const std::string &value, char separator) const;
+    std::vector<std::string> constraintNotes() const;
+    std::shared_future<PathInfo> probe(const std::string &path, unsigned probes);
+    const std::string* findOverride(int id) const;
+    template <class T> bool getAll(int id, char separator, std::vector<T> &vec);
+    template <class T> static bool convert(const std::string &str, T &val);
+    static bool convert(const std::string &str, std::string &val);
+    static uint32_t checksum(const char *data, std::string::size_type size);
+};
+
+
+/**
+   @brief A parameter made by CmdLineArgs::getLazyParam(), whose value is only converted when first used.
+   The conversion is then kept. An incorrect value is reported when the value is used.
+   @note A Lazy is not thread safe until its value was used once.
+ */
+template <class T>
+class CmdLineArgs::Lazy {
+public:
+
+    Lazy() :short_name_(' '), present_(false), state_(Unconverted) {}
+
+    bool isPresent() const { return present_; }
+    const T& get() const;
+    bool tryGet(T &val) const;
+    operator const T&() const { return get(); }
+
+private:
+    friend class CmdLineArgs;
+
+    enum State { Unconverted, Converted, Incorrect };
+
+    std::string long_name_;
+    char short_name_;
+    bool present_;
+    mutable std::string token_;     // The value as given on the command line, until converted
+    mutable State state_;
+    mutable T value_;               // The default value, or the converted one
+
+    bool convert() const;
+};
+
+
+/**
+   @brief What is known about a path given on the command line, after being probed by CmdLineArgs::getPath().
+ */
+struct CmdLineArgs::PathInfo {
+    std::string path;
+    int error;              ///< The errno of the first probe which failed, or 0.
+    bool exists;
+    bool is_file;
+    bool is_dir;
+    bool readable;
+    bool writable;
+    long long size;         ///< The size in bytes of a file.
+    int fd;                 ///< The file opened read-only with ProbeOpen, or -1. The caller must close it.
+};
+
+
+// A few threads probing the paths
+//
+class CmdLineArgs::ProbePool {
+public:
+    explicit ProbePool(unsigned nb_threads);
+    ~ProbePool();
+
+    std::shared_future<PathInfo> submit(const std::string &path, unsigned probes);
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::deque<std::packaged_task<PathInfo()> > tasks_;
+    bool stop_;
+    std::vector<std::thread> threads_;
+
+    void run();
+};
+
+
+/**
+   @brief To override some parsed values, for the current thread and the lifetime of the object.
+   The lookups by option index (rawValue, value, wasPresent) of the current thread see the overridden values first.
+   Overrides can be nested, the innermost winning, and must be destroyed in the reverse order of their creation,
+   as local variables are. Exple:
+   @code
+   CmdLineArgs::ScopedOverride tuning(cl);
+   tuning.set(cl.optionId("batch"), 64);
+   run();    // cl.value(batch_id, 0) gives 64 in this thread
+   @endcode
+ */
+class CmdLineArgs::ScopedOverride {
+public:
+    explicit ScopedOverride(const CmdLineArgs &cl);
+    ~ScopedOverride();
+
+    ScopedOverride(const ScopedOverride&) = delete;
+    ScopedOverride& operator=(const ScopedOverride&) = delete;
+
+    ScopedOverride& set(int id, const std::string &value);
+    template <class T> ScopedOverride& set(int id, const T &value);
+
+private:
+    friend class CmdLineArgs;
+
+    const CmdLineArgs *cl_;
+    ScopedOverride *prev_;
+    std::vector<std::pair<int, std::string> > values_;
+
+    static ScopedOverride*& current();
+};
+
+
+/**
+   @brief The errors of a line parsed by CmdLineArgs::parseBatch().
+ */
+struct CmdLineArgs::BatchErrors {
+    std::size_t line;               ///< The number of the line in the input, from 0.
+    std::vector<Error> errors;
+    std::string message;            ///< The messages of the errors, built with the arguments of the line.
+};
+
+
+/**
+   @brief A map of key=value pairs, made by CmdLineArgs::getMap().
+   The keys and values are stored one after another in a single buffer, indexed by an open addressing hash table,
+   so that thousands of pairs cost a few allocations.
+ */
+class CmdLineArgs::Map {
+public:
+
+    explicit Map(Duplicates duplicates=Duplicates::KeepLast) :duplicates_(duplicates) {}
+
+    bool insert(const std::string &key, const std::string &value);
+
+    std::size_t size() const { return entries_.size(); }
+    bool empty() const { return entries_.empty(); }
+    bool contains(const std::string &key) const;
+
+    // To get the value of a key:
+    const char* get(const std::string &key) const;
+    template <class T> T get(const std::string &key, T default_value) const;
+    std::string get(const std::string &key, const char *default_value) const;
+
+    // To get the pairs, in the order they were given:
+    const char* key(std::size_t i) const { return buffer_.data() + entries_[i].key; }
+    const char* value(std::size_t i) const { return buffer_.data() + entries_[i].value; }
+
+private:
+
+    struct Entry {
+        uint32_t key, key_size, value;      // Offsets of null terminated strings in buffer_
+        uint32_t hash;
+    };
+
+    Duplicates duplicates_;
+    std::string buffer_;
+    std::vector<Entry> entries_;
+    std::vector<int32_t> slots_;            // Index of the entries, or -1. The size is a power of 2.
+
+    std::size_t findSlot(const std::string &key, uint32_t hash) const;
+    void grow();
+    uint32_t store(const std::string &str);
+};
+
+
+/**
+   @brief A set of integers given as a list of ranges, such as "0-15,32-47" or "0-65535:4".
+   Each element of the list is a value ("5"), a range with its bounds included ("0-15"), or a range with a stride
+   ("0-65535:4" for 0, 4, 8...). The set only stores the ranges, so a huge set costs as little memory as a small one.
+   Overlapping ranges are allowed: each value of the set is counted and visited once, in increasing order.
+   It is used as any other parameter type: cl.getParam("cpus", CmdLineArgs::RangeSet("0-3"), "CPUs to use").
+ */
+class CmdLineArgs::RangeSet {
+public:
+
+    /// A range of values, from first to last included, by step.
+    struct Range {
+        long long first, last, step;
+    };
+
+    class const_iterator;
+
+    RangeSet() {}
+    explicit RangeSet(const std::string &str);
+    static bool parse(const std::string &str, RangeSet &set);
+
+    uint64_t size() const;
+    bool empty() const { return blocks_.empty(); }
+    bool contains(long long value) const;
+    const std::vector<Range>& ranges() const { return ranges_; }
+
+    const_iterator begin() const;
+    const_iterator end() const;
+
+    // To set the bits of the values of the set: (values out of the bitset are ignored)
+    template <std::size_t N> std::bitset<N> toBitset() const;
+#if defined(__linux__) && defined(CPU_SETSIZE)
+    void toCpuSet(cpu_set_t &cpus) const;
+#endif
+
+    std::string str() const;
+
+private:
+
+    // The values first + k*period + offset, for each offset of the block, up to last.
+    // The offsets are sorted, less than period, and the first one is 0.
+    // A period of 0 is for strided ranges whose period would have too many offsets: they are kept as they are.
+    struct Block {
+        long long first, last, period;
+        std::size_t offset, nb_offsets;     // The offsets of the block in offsets_, or its ranges in strided_
+    };
+
+    static const std::size_t max_offsets = 16;  // The offsets of a period, per range covering the block
+
+    std::vector<Range> ranges_;             // As given, sorted by first value, ranges with a step of 1 being merged
+    std::vector<Block> blocks_;             // The values of the ranges, without overlaps and sorted
+    std::vector<long long> offsets_;
+    std::vector<Range> strided_;            // The ranges of the blocks without period, from their first value in it
+
+    void normalize();
+    bool next(const Block &block, long long &base, std::size_t &pos) const;
+    uint64_t countUnion(const Range *ranges, std::size_t nb, long long origin, uint64_t x, uint64_t step, uint64_t last) const;
+    static bool intersect(uint64_t x, uint64_t step, uint64_t r, uint64_t s, uint64_t last, uint64_t &y, uint64_t &common);
+    static uint64_t gcd(uint64_t a, uint64_t b);
+    static bool parseValue(const char *&pos, long long &value);
+};
+
+
+/**
+   @brief To iterate over the values of a RangeSet, in increasing order.
+ */
+class CmdLineArgs::RangeSet::const_iterator {
+public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef long long value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const long long* pointer;
+    typedef long long reference;
+
+    const_iterator(const RangeSet *set, std::size_t idx)
+        :set_(set), idx_(idx), base_(idx < set->blocks_.size() ? set->blocks_[idx].first : 0), pos_(0) {}
+
+    long long operator*() const {
+        const Block &block = set_->blocks_[idx_];
+        return block.period ? base_ + set_->offsets_[block.offset + pos_] : base_;
+    }
+
+    const_iterator& operator++() {
+        if( !set_->next(set_->blocks_[idx_], base_, pos_) ) {
+            pos_ = 0;
+            base_ = ++idx_ < set_->blocks_.size() ? set_->blocks_[idx_].first : 0;
+        }
+        return *this;
+    }
+
+    const_iterator operator++(int) { const_iterator it(*this); ++*this; return it; }
+
+    bool operator==(const const_iterator &other) const { return idx_ == other.idx_ && base_ == other.base_ && pos_ == other.pos_; }
+    bool operator!=(const const_iterator &other) const { return !(*this == other); }
+
+private:
+    const RangeSet *set_;
+    std::size_t idx_;           // The block
+    long long base_;            // The start of the current period of the block, or the value without period
+    std::size_t pos_;           // The offset in the period
+};
+
+
+/**
+   @brief A read-only view of the result of a parsing, made by CmdLineArgs::snapshot().
+   The image holds the options with their values and the remaining arguments. It contains only offsets, so it can
+   be mapped at any address, typically by forked or spawned processes, and queried without any parsing or copy.
+ */
+class CmdLineArgs::Snapshot {
+public:
+
+    Snapshot(const void *data, std::size_t size);
+    static Snapshot map(int fd);
+
+    Snapshot(Snapshot &&other);
+    Snapshot(const Snapshot&) = delete;
+    Snapshot& operator=(const Snapshot&) = delete;
+    ~Snapshot();
+
+    // To query the options, as done with CmdLineArgs:
+    bool isPresent(const std::string &long_name) const;
+    int getFlag(const std::string &long_name) const;
+    const char* getValue(const std::string &long_name) const;
+    template <class T> T getParam(const std::string &long_name, T default_value) const;
+    std::string getParam(const std::string &long_name, const char *default_value) const;
+
+    // The remaining arguments:
+    unsigned nbRemaining() const;
+    const char* getRemaining(unsigned i) const;
+
+    /// @cond SNAPSHOT_FORMAT
+    static const uint32_t magic = 0x31414c43;   // "CLA1"
+    static const uint32_t version = 1;
+
+    struct Header {
+        uint32_t magic, version, size, checksum;
+        uint32_t nb_options, nb_args;
+    };
+
+    struct Entry {
+        uint32_t name, value;       // Offsets of null terminated strings. value is 0 when the option is absent.
+        int32_t count;
+    };
+    /// @endcond
+
+private:
+
+    const char *data_;
+    std::size_t map_size_;          // Non zero when data_ is mapped by map()
+
+    const Header& header() const { return *reinterpret_cast<const Header*>(data_); }
+    const Entry* entries() const { return reinterpret_cast<const Entry*>(data_ + sizeof(Header)); }
+    const uint32_t* args() const { return reinterpret_cast<const uint32_t*>(entries() + header().nb_options); }
+    const Entry* find(const std::string &long_name) const;
 };
 
 
@@ -100,222 +602,639 @@ std::vector<std::string> CmdLineArgs::split(const std::string &s, char delim)
    @param argv the array of char* containing the arguments. (is typicaly main argv parameter)
    @param usage_intro A sting giving a short summary of what the programs does.
    @param allow_set_with_equal When true, parameters can also be set with an equal sign. Exple: "--param=10"
-   That is the default. The only consequence is that '=' is not allowed in a parameter value.
+   That is the default. Only the first '=' of an option is used, so values can contain some. Exple: "--define=k=v"
    @note It is expected that the first argument in argv to be the program name. It will be discarded.
  */
 CmdLineArgs::CmdLineArgs(int argc, char **argv, const std::string &usage_intro, bool allow_set_with_equal)
-    :usage_intro_(usage_intro)
+    :allow_set_with_equal_(allow_set_with_equal), usage_intro_(usage_intro)
 {
-    for(int i=1; i<argc; ++i) {
-        if (allow_set_with_equal) {
-            auto vec = split(argv[i], '=');
-            args_.reserve(args_.size() + vec.size());
-            args_.insert(args_.end(), vec.begin(), vec.end());
-        } else {
-            args_.push_back(argv[i]);
-        }
-    }
+    for(int i=1; i<argc; ++i)
+        pushArg(argv[i], std::strlen(argv[i]));
 
     usage_intro_ += "\nOptions are:";
 }
 
 
-// To find an argument which is a long name (starting with "--")
-//
-std::vector<std::string>::iterator CmdLineArgs::findLongName(const std::string &name)
+/**
+   @brief Constructor, passing a whole command line.
+   @param cmd_line the arguments, separated by spaces and quoted as in a POSIX shell. Exple: "--name 'hello me' -v"
+   @param usage_intro A sting giving a short summary of what the programs does.
+   @param allow_set_with_equal When true, parameters can also be set with an equal sign. Exple: "--param=10"
+   @note Contrary to argv, cmd_line does not start with the program name.
+ */
+CmdLineArgs::CmdLineArgs(const std::string &cmd_line, const std::string &usage_intro, bool allow_set_with_equal)
+    :allow_set_with_equal_(allow_set_with_equal), usage_intro_(usage_intro)
 {
-    std::vector<std::string>::iterator pos;
-    bool found = false;
+    parseCmdLine(cmd_line);
+    usage_intro_ += "\nOptions are:";
+}
 
-    for( pos=args_.begin(); pos!=args_.end(); ++pos ) {
 
-        if( pos->size()<3 || pos->substr(0,2) != "--")
-            continue;
+/**
+   @brief To parse new arguments with the options defined by the previous parsing.
+   The next calls to getParam, getParams and getFlag must define the same options, in the same order.
+   The usage of the options is not built again, and the buffers are reused.
+   @param argc the number of arguments.
+   @param argv the arguments, the first one being the program name.
+   @note To parse in several threads, use a CmdLineArgs per thread.
+ */
+void CmdLineArgs::reset(int argc, char **argv)
+{
+    rewind();
+    for(int i=1; i<argc; ++i)
+        pushArg(argv[i], std::strlen(argv[i]));
+}
 
-        if( pos->substr(2) == name.substr(0,pos->size()-2) ){
-            found = true;
-            break;
-        }
-    }
 
-    return found ? pos : args_.end();
+/**
+   @brief To parse a new command line with the options defined by the previous parsing.
+   @param cmd_line the arguments, quoted as in a POSIX shell.
+   @see reset(int, char**)
+ */
+void CmdLineArgs::reset(const std::string &cmd_line)
+{
+    rewind();
+    parseCmdLine(cmd_line);
 }
 
 
-// To find an argument which is a short name (starting with a single "-")
-//
-std::vector<std::string>::iterator CmdLineArgs::findShortName(char name)
+/**
+   @brief To split a command line into arguments, following the POSIX shell rules.
+   Arguments are separated by blanks. Characters are taken literally between single quotes, and between double
+   quotes except for \\, \" \$ and \` which are escaped. Outside of quotes, a backslash escapes the next character.
+   @param cmd_line the command line.
+   @return the arguments.
+   @throw runtime_error if a quote is not terminated.
+ */
+std::vector<std::string> CmdLineArgs::tokenize(const std::string &cmd_line)
 {
-    if(name==' ')
-        return args_.end();
+    std::vector<std::string> tokens;
+    std::string token;
 
-    std::vector<std::string>::iterator pos;
-    bool found = false;
+    if( tokenize(cmd_line, token, [&tokens](const std::string &tok){ tokens.push_back(tok); }) != std::string::npos )
+        throw std::runtime_error("\nError: unterminated quote in the command line");
+
+    return tokens;
+}
 
-    for(pos=args_.begin(); pos!=args_.end(); ++pos){
 
-        if( pos->size()<2 || (*pos)[0] != '-')
-            continue;
+// Split the command line, calling add for each argument. token is the buffer used to build the arguments.
+// Returns the position of an unterminated quote, or npos.
+//
+template <class F>
+std::string::size_type CmdLineArgs::tokenize(const std::string &cmd_line, std::string &token, F add)
+{
+    bool in_token = false;
+    token.clear();
 
-        if((*pos)[1] == '-')
+    for( std::string::size_type i=0; i<cmd_line.size(); ++i ) {
+        char c = cmd_line[i];
+
+        if( c == ' ' || c == '\t' || c == '\n' ) {
+            if( in_token )
+                add(token);
+            token.clear();
+            in_token = false;
             continue;
+        }
 
-        std::string::size_type idx = pos->find(name,1);
-        if( idx != std::string::npos ) {
-            found = true;
-            break;
+        if( c == '\'' || c == '"' )
+            in_token = true;
+
+        if( c == '\'' ) {
+            std::string::size_type end = cmd_line.find('\'', i+1);
+            if( end == std::string::npos )
+                return i;
+            token.append(cmd_line, i+1, end-i-1);
+            i = end;
+
+        } else if( c == '"' ) {
+            std::string::size_type quote = i;
+            for( ++i; i<cmd_line.size() && cmd_line[i] != '"'; ++i ) {
+                if( cmd_line[i] == '\\' && i+1 < cmd_line.size() ) {
+                    char next = cmd_line[i+1];
+                    if( next == '\\' || next == '"' || next == '$' || next == '`' ) {
+                        token += next;
+                        ++i;
+                        continue;
+                    }
+                    if( next == '\n' ) {
+                        ++i;
+                        continue;
+                    }
+                }
+                token += cmd_line[i];
+            }
+            if( i == cmd_line.size() )
+                return quote;
+
+        } else if( c == '\\' ) {
+            // A backslash-newline only joins the lines:
+            if( ++i < cmd_line.size() && cmd_line[i] != '\n' ) {
+                token += cmd_line[i];
+                in_token = true;
+            }
+
+        } else {
+            token += c;
+            in_token = true;
         }
     }
 
-    return found ? pos : args_.end();
+    if( in_token )
+        add(token);
+
+    return std::string::npos;
 }
 
 
-/**
-   @brief To get a parameter (so an argument starting with "--" or "-", followed by a value)
-   @param long_name long name of the parameter (so starting with "--").
-   @param short_name short name of the parameter (so a single letter starting with "-").
-   @param default_value default value to give if the parameter is not present.
-   @param desc A description of the parameter. (will go into the usage)
-   @return The value of the parameter.
- */
-template <class T>
-T CmdLineArgs::getParam(const std::string &long_name, char short_name, T default_value, const std::string &desc)
+// Add an argument. An option is split at its first equal sign when allowed, so that its value can contain some.
+//
+void CmdLineArgs::pushArg(const char *arg, std::string::size_type size)
 {
-    T val;
-    std::ostringstream oss;
-    oss << default_value;
-    addUsage(long_name, short_name, oss.str(), desc);
+    const char *equal = nullptr;
+    if( allow_set_with_equal_ && size > 1 && arg[0] == '-' )
+        equal = static_cast<const char*>(std::memchr(arg, '=', size));
 
-    // First search the long names:
-    //
-    auto pos = findLongName(long_name);
-    if( pos != args_.end() ) {
+    if( !equal ) {
+        args_.emplace_back(arg, size);
+        return;
+    }
 
-        if( pos+2 > args_.end() )
-            throw std::runtime_error("\nError: parameter --" + long_name + " is not followed by a value");
+    args_.emplace_back(arg, equal-arg);
+    if( equal+1 < arg+size )
+        args_.emplace_back(equal+1, arg+size-equal-1);
+}
 
-        pos = args_.erase(pos);
 
-    } else {
+// Split a command line and add its arguments
+//
+void CmdLineArgs::parseCmdLine(const std::string &cmd_line)
+{
+    std::string::size_type quote = tokenize(cmd_line, token_, [this](const std::string &tok){
+        pushArg(tok.data(), tok.size());
+    });
 
-        pos = findShortName(short_name);
-        if( pos != args_.end() ) {
+    if( quote != std::string::npos )
+        fail(ErrorCode::UnterminatedQuote, quote);
+}
 
-            if( pos+2>args_.end() )
-                throw std::runtime_error("\nError: parameter -" + std::string(1,short_name) + " is not followed by a value");
 
-            if( pos->size()==2 )
-                pos = args_.erase(pos);
-            else {
-                pos->erase(pos->find(short_name, 1), 1);
-                ++pos;
-            }
-        }
+// Forget the arguments and errors of the previous parsing, keeping the options.
+//
+void CmdLineArgs::rewind()
+{
+    args_.clear();
+    errors_.clear();
+    for( auto &opt: options_ ) {
+        opt.count = 0;
+        opt.value.clear();
+        opt.separator = '\0';
     }
+    std::fill(present_.begin(), present_.end(), 0);
+    compiled_ = true;
+    next_option_ = 0;
+}
 
-    if ( pos != args_.end() ) {
 
-        std::istringstream ss(*pos);
-        ss >> val;
+// Return the index of the option if it was defined by a previous parsing, or -1.
+// The options usually come back in the same order, so the next one is checked before the index of the names.
+//
+int CmdLineArgs::nextDefinedOption(const std::string &long_name)
+{
+    if( !compiled_ )
+        return -1;
+    if( next_option_ < options_.size() && options_[next_option_].long_name == long_name )
+        return next_option_++;
+
+    int id = findId(long_name);
+    if( id >= 0 )
+        next_option_ = id + 1;
+    return id;
+}
 
-        if( ss.fail() )
-            throw std::runtime_error("\nError: parameter --" + long_name + " is not followed by a correct value");
 
-        if( !ss.eof() ) {
-            std::stringstream sshex;
-            sshex << std::hex << *pos;
-            sshex >> val;
+// To tell if an argument is a long name (starting with "--"), or an abbreviation of it
+//
+bool CmdLineArgs::isLongName(const std::string &arg, const std::string &name)
+{
+    if( arg.size()<3 || arg.compare(0,2,"--") != 0 )
+        return false;
 
-            if(sshex.fail())
-                throw std::runtime_error("\nError: parameter --" + long_name + " is not followed by a correct value");
+    return name.compare(0,arg.size()-2,arg,2,std::string::npos) == 0;
+}
 
-            if(!sshex.eof())
-                throw std::runtime_error("\nError: parameter --" + long_name + " has an incorrect value");
-        }
 
-        args_.erase(pos);
-        return val;
+// To tell if an argument contains a short name (so starts with a single "-")
+//
+bool CmdLineArgs::hasShortName(const std::string &arg, char name)
+{
+    if( name==' ' || arg.size()<2 || arg[0] != '-' || arg[1] == '-' )
+        return false;
 
-    } else
-        return default_value;
+    return arg.find(name,1) != std::string::npos;
 }
 
 
-/**
-   @brief To get a parameter, no short name allowed.
-   @param long_name long name of the parameter (so starting with "--").
-   @param default_value default value to give if the parameter is not present.
-   @param desc A description of the parameter. (will go into the usage)
-   @return the value of the parameter.
- */
-template <class T>
-T CmdLineArgs::getParam(const std::string &long_name, T default_value, const std::string &desc)
+// To find an argument which is a long name (starting with "--")
+//
+std::vector<std::string>::iterator CmdLineArgs::findLongName(const std::string &name)
 {
-    return getParam<T>(long_name, ' ', default_value, desc);
+    return std::find_if(args_.begin(), args_.end(), [&name](const std::string &arg){ return isLongName(arg, name); });
 }
 
 
-/**
-   @brief To get a parameter with multiple values.
-   @param long_name long name of the parameter (so starting with "--").
-   @param short_name short name of the parameter (so a single letter starting with "-").
-   @param default_vals default values to give if the parameter is not present.
-   @param enforce_default_size When true, expect to have the same number of elements than default_vals. If only one value is given,
-   will replicate the value. If a different number of values is given will throw.
-   @param desc A description of the parameter. (will go into the usage)
-   @param separator the character used to separate values. Multiple of them will be ignored and compressed to one.
-   Also there is not way of escaping a separator (no way the values can contain this separartor)
-   @return the values of the parameter, returned as a vector.
- */
-template <class T>
-std::vector<T> CmdLineArgs::getParams(const std::string &long_name, char short_name,
-                                      const std::vector<T> &default_vals, bool enforce_default_size,
-                                      const std::string &desc, char separator)
+// To find an argument which is a short name (starting with a single "-")
+//
+std::vector<std::string>::iterator CmdLineArgs::findShortName(char name)
 {
-    // Join the default values with the separator for the usage
-    //
-    std::ostringstream oss;
-    for(unsigned int i=0; i<default_vals.size(); i++){
-        if(i>0)
-            oss << ",";
-        oss << default_vals[i];
-    }
-    addUsage(long_name, short_name, oss.str(), desc);
+    return std::find_if(args_.begin(), args_.end(), [name](const std::string &arg){ return hasShortName(arg, name); });
+}
 
-    T val;
-    std::vector<T> vec;
-    std::istringstream ss;
 
-    auto pos = findLongName(long_name);
+// To find the value of a parameter, removing the parameter name from the arguments.
+// Returns args_.end() if the parameter is absent or not followed by a value.
+//
+std::vector<std::string>::iterator CmdLineArgs::findValue(int id)
+{
+    Option &opt = options_[id];
+
+    // First search the long names:
+    auto pos = findLongName(opt.long_name);
     if( pos != args_.end() ) {
 
-        if(pos+2>args_.end())
-            throw std::runtime_error("\nError: parameter --" + long_name + " is not followed by a value");
+        if( pos+2 > args_.end() ) {
+            fail(ErrorCode::MissingValue, id);
+            args_.erase(pos);
+            return args_.end();
+        }
 
         pos = args_.erase(pos);
+        opt.count = 1;
+        opt.value = *pos;
+        setPresent(id);
+        return pos;
+    }
 
-    } else {
-
-        pos = findShortName(short_name);
-        if( pos != args_.end() ) {
+    // Then search the short names:
+    pos = findShortName(opt.short_name);
+    if( pos != args_.end() ) {
 
-            if( pos+2>args_.end() )
-                throw std::runtime_error("\nError: parameter -" + std::string(1,short_name) + " is not followed by a value");
+        bool missing = pos+2 > args_.end();
+        if( missing )
+            fail(ErrorCode::MissingValue, id);
 
-            if( pos->size()==2 )
-                pos = args_.erase(pos);
-            else{
-                pos->erase( pos->find(short_name, 1), 1 );
-                ++pos;
-            }
+        if( pos->size()==2 )
+            pos = args_.erase(pos);
+        else {
+            pos->erase(pos->find(opt.short_name, 1), 1);
+            ++pos;
         }
 
+        if( missing )
+            return args_.end();
+
+        opt.count = 1;
+        opt.value = *pos;
+        setPresent(id);
+        return pos;
     }
 
+    return args_.end();
+}
+
+
+// To convert a value, in decimal or else in hexadecimal.
+//
+template <class T>
+bool CmdLineArgs::convert(const std::string &str, T &val)
+{
+    std::istringstream ss(str);
+    ss >> val;
+
+    if( ss.fail() )
+        return false;
+
+    if( !ss.eof() ) {
+        std::istringstream sshex(str);
+        sshex >> std::hex >> val;
+
+        if( sshex.fail() || !sshex.eof() )
+            return false;
+    }
+
+    return true;
+}
+
+
+/// @cond SPECIALISATIONS
+bool CmdLineArgs::convert(const std::string &str, std::string &val)
+{
+    val = str;
+    return true;
+}
+/// @endcond
+
+
+// To get the values of all the occurrences of a parameter, in a single pass over the arguments.
+// Each value is split at the separator (unless it is '\0'), empty values being ignored.
+// The occurrences are joined in the value of the option with the separator, or with a new line without separator.
+// Returns false if a value is not correct.
+//
+template <class T>
+bool CmdLineArgs::getAll(int id, char separator, std::vector<T> &vec)
+{
+    Option &opt = options_[id];
+
+    // Count the values first, to allocate the vector only once:
+    std::vector<std::string>::size_type nb = 0;
+    for( auto pos=args_.begin(); pos!=args_.end(); ++pos )
+        if( (isLongName(*pos, opt.long_name) || hasShortName(*pos, opt.short_name)) && pos+1 != args_.end() ) {
+            ++pos;
+            nb += separator ? std::count(pos->begin(), pos->end(), separator) + 1 : 1;
+        }
+    vec.reserve(vec.size() + nb);
+
+    // Then get them, keeping the other arguments in place:
+    bool ok = true;
+    T val;
+    std::string item;
+    auto kept = args_.begin();
+    for( auto pos=args_.begin(); pos!=args_.end(); ++pos ) {
+
+        bool is_long = isLongName(*pos, opt.long_name);
+        if( !is_long && !hasShortName(*pos, opt.short_name) ) {
+            if( kept != pos )
+                *kept = std::move(*pos);
+            ++kept;
+            continue;
+        }
+
+        // Other short flags aggregated with the short name stay:
+        if( !is_long && pos->size() > 2 ) {
+            pos->erase(pos->find(opt.short_name, 1), 1);
+            if( kept != pos )
+                *kept = std::move(*pos);
+            ++kept;
+        }
+
+        if( pos+1 == args_.end() ) {
+            fail(ErrorCode::MissingValue, id);
+            break;
+        }
+
+        ++pos;
+        opt.separator = separator ? separator : '\n';
+        if( opt.count++ )
+            opt.value += opt.separator;
+        else
+            setPresent(id);
+        opt.value += *pos;
+
+        std::string::size_type begin = 0;
+        while( begin <= pos->size() ) {
+            std::string::size_type end = separator ? pos->find(separator, begin) : std::string::npos;
+            if( end == std::string::npos )
+                end = pos->size();
+
+            if( end > begin ) {
+                item.assign(*pos, begin, end-begin);
+                if( convert(item, val) )
+                    vec.push_back(val);
+                else if( ok ) {
+                    ok = false;
+                    fail(ErrorCode::IncorrectValue, id);
+                }
+            }
+            begin = end+1;
+        }
+    }
+    args_.erase(kept, args_.end());
+
+    return ok;
+}
+
+
+/**
+   @brief To get a parameter (so an argument starting with "--" or "-", followed by a value)
+   @param long_name long name of the parameter (so starting with "--").
+   @param short_name short name of the parameter (so a single letter starting with "-").
+   @param default_value default value to give if the parameter is not present.
+   @param desc A description of the parameter. (will go into the usage)
+   @return The value of the parameter.
+ */
+template <class T>
+T CmdLineArgs::getParam(const std::string &long_name, char short_name, T default_value, const std::string &desc)
+{
+    int id = nextDefinedOption(long_name);
+    if( id < 0 ) {
+        std::ostringstream oss;
+        oss << default_value;
+        id = addUsage(long_name, short_name, oss.str(), desc);
+    }
+
+    auto pos = findValue(id);
+    if ( pos != args_.end() ) {
+
+        T val;
+        bool ok = convert(*pos, val);
+        args_.erase(pos);
+
+        if( ok )
+            return val;
+
+        fail(ErrorCode::IncorrectValue, id);
+    }
+
+    return default_value;
+}
+
+
+/**
+   @brief To get a parameter, no short name allowed.
+   @param long_name long name of the parameter (so starting with "--").
+   @param default_value default value to give if the parameter is not present.
+   @param desc A description of the parameter. (will go into the usage)
+   @return the value of the parameter.
+ */
+template <class T>
+T CmdLineArgs::getParam(const std::string &long_name, T default_value, const std::string &desc)
+{
+    return getParam<T>(long_name, ' ', default_value, desc);
+}
+
+
+/**
+   @brief To get a parameter which is only converted when its value is first used.
+   For a parameter which is not always used, the cost of its conversion is only paid when needed.
+   @param long_name long name of the parameter (so starting with "--").
+   @param short_name short name of the parameter (so a single letter starting with "-").
+   @param default_value default value to give if the parameter is not present.
+   @param desc A description of the parameter. (will go into the usage)
+   @return the parameter, whose value is given by get(). get() throws if the value is incorrect.
+   @note With convertEagerly(), the value is converted at once, and an incorrect value reported as by getParam.
+ */
+template <class T>
+CmdLineArgs::Lazy<T> CmdLineArgs::getLazyParam(const std::string &long_name, char short_name, T default_value, const std::string &desc)
+{
+    int id = nextDefinedOption(long_name);
+    if( id < 0 ) {
+        std::ostringstream oss;
+        oss << default_value;
+        id = addUsage(long_name, short_name, oss.str(), desc);
+    }
+
+    Lazy<T> param;
+    param.long_name_ = long_name;
+    param.short_name_ = short_name;
+    param.value_ = default_value;
+
+    auto pos = findValue(id);
     if( pos != args_.end() ) {
+        param.present_ = true;
+        param.token_ = std::move(*pos);
+        args_.erase(pos);
+
+        // As getParam, an incorrect value gives the default value when collecting the errors:
+        if( eager_ && !param.convert() ) {
+            param.value_ = default_value;
+            param.state_ = Lazy<T>::Converted;
+            fail(ErrorCode::IncorrectValue, id);
+        }
+    }
+
+    return param;
+}
+
+
+/**
+   @brief To get a parameter which is only converted when its value is first used, no short name allowed.
+   @see getLazyParam(const std::string&, char, T, const std::string&)
+ */
+template <class T>
+CmdLineArgs::Lazy<T> CmdLineArgs::getLazyParam(const std::string &long_name, T default_value, const std::string &desc)
+{
+    return getLazyParam<T>(long_name, ' ', default_value, desc);
+}
+
+
+/**
+   @brief To convert the lazy parameters as soon as they are retrieved, to check all the values at parsing time.
+   @param eager When true, getLazyParam converts the value at once, reporting an incorrect value as getParam does.
+ */
+void CmdLineArgs::convertEagerly(bool eager)
+{
+    eager_ = eager;
+}
+
+
+/**
+   @brief To get the value of the parameter, converting it the first time.
+   @return the value, or the default value if the parameter is not present.
+   @throw runtime_error if the value is not correct.
+ */
+template <class T>
+const T& CmdLineArgs::Lazy<T>::get() const
+{
+    if( !convert() ) {
+        std::string msg("\nError: parameter --" + long_name_);
+        if( short_name_ != ' ' )
+            msg += " (-" + std::string(1,short_name_) + ")";
+        throw std::runtime_error(msg + " is not followed by a correct value");
+    }
+
+    return value_;
+}
+
+
+/**
+   @brief To get the value of the parameter, converting it the first time, without throwing.
+   @param val receives the value, or the default value if the parameter is not present.
+   @return false if the value is not correct.
+ */
+template <class T>
+bool CmdLineArgs::Lazy<T>::tryGet(T &val) const
+{
+    if( !convert() )
+        return false;
+
+    val = value_;
+    return true;
+}
+
+
+// Convert the value the first time, and tell if it is correct
+//
+template <class T>
+bool CmdLineArgs::Lazy<T>::convert() const
+{
+    if( state_ == Unconverted && present_ ) {
+        state_ = CmdLineArgs::convert(token_, value_) ? Converted : Incorrect;
+        if( state_ == Converted )
+            std::string().swap(token_);
+    }
+
+    return state_ != Incorrect;
+}
+
+
+/**
+   @brief To get a parameter with multiple values.
+   @param long_name long name of the parameter (so starting with "--").
+   @param short_name short name of the parameter (so a single letter starting with "-").
+   @param default_vals default values to give if the parameter is not present.
+   @param enforce_default_size When true, expect to have the same number of elements than default_vals. If only one value is given,
+   will replicate the value. If a different number of values is given will throw.
+   @param desc A description of the parameter. (will go into the usage)
+   @param separator the character used to separate values. Multiple of them will be ignored and compressed to one.
+   Also there is not way of escaping a separator (no way the values can contain this separartor)
+   @param accumulate When true, the values of all the occurrences of the parameter are gathered, in a single pass.
+   Exple: "--num 1,2 --num 3". Otherwise only the first occurrence is used.
+   @return the values of the parameter, returned as a vector.
+ */
+template <class T>
+std::vector<T> CmdLineArgs::getParams(const std::string &long_name, char short_name,
+                                      const std::vector<T> &default_vals, bool enforce_default_size,
+                                      const std::string &desc, char separator, bool accumulate)
+{
+    // Join the default values with the separator for the usage
+    //
+    int id = nextDefinedOption(long_name);
+    if( id < 0 ) {
+        std::ostringstream oss;
+        for(unsigned int i=0; i<default_vals.size(); i++){
+            if(i>0)
+                oss << ",";
+            oss << default_vals[i];
+        }
+        id = addUsage(long_name, short_name, oss.str(), desc);
+    }
+
+    T val;
+    std::vector<T> vec;
+    std::istringstream ss;
+
+    if( accumulate ) {
+
+        if( !getAll(id, separator, vec) )
+            return default_vals;
+        if( !options_[id].count )
+            return default_vals;
+
+    } else {
+
+        auto pos = findValue(id);
+        if( pos == args_.end() )
+            return default_vals;
+        options_[id].separator = separator;
+
         do {
 
+            if( !vec.empty() ) {
+                options_[id].value += separator;
+                options_[id].value += *pos;
+            }
+
             ss.clear();
             ss.str(*pos);
             pos = args_.erase(pos);
@@ -326,31 +1245,24 @@ std::vector<T> CmdLineArgs::getParams(const std::string &long_name, char short_n
                     ss.ignore();
             }
 
-            if( !ss.eof() )
-                throw std::runtime_error("\nError: parameter --" + long_name +
-                                         " (-" + std::string(1,short_name) +
-                                         ") is not followed by a correct value");
+            if( !ss.eof() ) {
+                fail(ErrorCode::IncorrectValue, id);
+                return default_vals;
+            }
 
         } while ( enforce_default_size && vec.size() < default_vals.size() && pos < args_.end() && (*pos)[0] != '-' );
+    }
 
-        if ( enforce_default_size && vec.size() == 1 )
-            for( int i=1; i<default_vals.size(); ++i)
-                vec.push_back(vec[0]);
-
-        if ( enforce_default_size && vec.size() != default_vals.size() ) {
-            std::ostringstream oss;
-            oss << "\nError: parameter --" << long_name;
-            if ( short_name != ' ' )
-                oss << " (-" << std::string(1,short_name) << ")";
-            oss << " is not followed by " << default_vals.size() << " values as expected.";
-            throw std::runtime_error(oss.str());
-        }
+    if ( enforce_default_size && vec.size() == 1 )
+        for( unsigned i=1; i<default_vals.size(); ++i)
+            vec.push_back(vec[0]);
 
-        return vec;
+    if ( enforce_default_size && vec.size() != default_vals.size() ) {
+        fail(ErrorCode::WrongNbValues, id, default_vals.size());
+        return default_vals;
     }
 
-    // did not find anything:
-    return default_vals;
+    return vec;
 }
 
 
@@ -362,14 +1274,55 @@ std::vector<T> CmdLineArgs::getParams(const std::string &long_name, char short_n
    will replicate the value. If a different number of values is given will throw.
    @param desc A description of the parameter. (will go into the usage)
    @param separator the character used to separate values.
+   @param accumulate When true, the values of all the occurrences of the parameter are gathered.
    @return the values of the parameter, returned as a vector.
  */
 template <class T>
 std::vector<T> CmdLineArgs::getParams(const std::string &long_name,
                                       const std::vector<T> &default_vals, bool enforce_default_size,
-                                      const std::string &desc, char separator)
+                                      const std::string &desc, char separator, bool accumulate)
+{
+    return getParams<T>(long_name, ' ', default_vals, enforce_default_size, desc, separator, accumulate);
+}
+
+
+/**
+   @brief To get the values of all the occurrences of a parameter, in the order of the command line.
+   Exple: "--input a -i b --input c,d" gives a, b, c and d with ',' as separator.
+   @param long_name long name of the parameter (so starting with "--").
+   @param short_name short name of the parameter (so a single letter starting with "-").
+   @param desc A description of the parameter. (will go into the usage)
+   @param separator the character used to separate several values given at once. '\0' (the default) for none.
+   Empty values are ignored.
+   @return the values, or an empty vector if the parameter is not present.
+   @note The arguments are parsed in a single pass, whatever the number of occurrences.
+ */
+template <class T>
+std::vector<T> CmdLineArgs::getAllParams(const std::string &long_name, char short_name, const std::string &desc, char separator)
+{
+    int id = nextDefinedOption(long_name);
+    if( id < 0 )
+        id = addUsage(long_name, short_name, "", desc);
+
+    std::vector<T> vec;
+    if( !getAll(id, separator, vec) )
+        vec.clear();
+
+    return vec;
+}
+
+
+/**
+   @brief To get the values of all the occurrences of a parameter, no short name.
+   @param long_name long name of the parameter (so starting with "--").
+   @param desc A description of the parameter. (will go into the usage)
+   @param separator the character used to separate several values given at once. '\0' (the default) for none.
+   @return the values, or an empty vector if the parameter is not present.
+ */
+template <class T>
+std::vector<T> CmdLineArgs::getAllParams(const std::string &long_name, const std::string &desc, char separator)
 {
-    return getParams<T>(long_name, ' ', default_vals, enforce_default_size, desc, separator);
+    return getAllParams<T>(long_name, ' ', desc, separator);
 }
 
 
@@ -382,7 +1335,9 @@ std::vector<T> CmdLineArgs::getParams(const std::string &long_name,
  */
 int CmdLineArgs::getFlag(const std::string &long_name, char short_name, const std::string &desc)
 {
-    addUsage(long_name,short_name,"",desc);
+    int id = nextDefinedOption(long_name);
+    if( id < 0 )
+        id = addUsage(long_name,short_name,"",desc);
 
     int nb=0;
 
@@ -405,6 +1360,9 @@ int CmdLineArgs::getFlag(const std::string &long_name, char short_name, const st
         pos = findShortName(short_name);
     }
 
+    options_[id].count = nb;
+    if( nb )
+        setPresent(id);
     return nb;
 }
 
@@ -427,40 +1385,14 @@ int CmdLineArgs::getFlag(const std::string &long_name, const std::string &desc)
 //
 std::string CmdLineArgs::getParam(const std::string &long_name, char short_name, const std::string &default_value, const std::string &desc)
 {
-    std::string val;
-    addUsage(long_name, short_name, "\"" + default_value + "\"", desc);
-
-    // First search the long names:
-    auto pos = findLongName(long_name);
-    if( pos != args_.end() ) {
-
-        if(pos+2>args_.end())
-            throw std::runtime_error("\nError: parameter --" + long_name + " is not followed by a value");
-
-        pos = args_.erase(pos);
-        val = *pos;
-        args_.erase(pos);
-
-        return val;
-    }
+    int id = nextDefinedOption(long_name);
+    if( id < 0 )
+        id = addUsage(long_name, short_name, "\"" + default_value + "\"", desc);
 
-    // Then search the short names:
-    pos = findShortName(short_name);
+    auto pos = findValue(id);
     if( pos != args_.end() ) {
-
-        if(pos+2>args_.end())
-            throw std::runtime_error("\nError: parameter -" + std::string(1,short_name) + " is not followed by a value");
-
-        if(pos->size()==2)
-            pos = args_.erase(pos);
-        else{
-            pos->erase(pos->find(short_name,1),1);
-            ++pos;
-        }
-
-        val = *pos;
+        std::string val(std::move(*pos));
         args_.erase(pos);
-
         return val;
     }
 
@@ -468,6 +1400,16 @@ std::string CmdLineArgs::getParam(const std::string &long_name, char short_name,
     return default_value;
 }
 
+CmdLineArgs::Lazy<std::string> CmdLineArgs::getLazyParam(const std::string &long_name, char short_name, const char* default_value, const std::string &desc)
+{
+    return getLazyParam<std::string>(long_name, short_name, default_value, desc);
+}
+
+CmdLineArgs::Lazy<std::string> CmdLineArgs::getLazyParam(const std::string &long_name, const char* default_value, const std::string &desc)
+{
+    return getLazyParam<std::string>(long_name, ' ', default_value, desc);
+}
+
 std::string CmdLineArgs::getParam(const std::string &long_name, const std::string &default_value, const std::string &desc)
 {
     return getParam(long_name,' ',default_value,desc);
@@ -488,68 +1430,45 @@ std::string CmdLineArgs::getParam(const std::string &long_name, const char* defa
 //
 std::vector<std::string> CmdLineArgs::getParams(const std::string &long_name, char short_name,
                                                 const std::vector<std::string> &default_vals, bool enforce_default_size,
-                                                const std::string &desc, char separator)
+                                                const std::string &desc, char separator, bool accumulate)
 {
     // Join the default values with the separator for the usage
     //
-    std::ostringstream oss;
-    for(unsigned int i=0; i!=default_vals.size(); i++){
-        if(i>0)
-            oss << ",";
-        oss << default_vals[i];
+    int id = nextDefinedOption(long_name);
+    if( id < 0 ) {
+        std::ostringstream oss;
+        for(unsigned int i=0; i!=default_vals.size(); i++){
+            if(i>0)
+                oss << ",";
+            oss << default_vals[i];
+        }
+        id = addUsage(long_name,short_name,oss.str(),desc);
     }
-    addUsage(long_name,short_name,oss.str(),desc);
 
-    std::string val;
     std::vector<std::string> vec;
 
-    // First search the long names:
-    //
-    auto pos = findLongName(long_name);
-    if( pos != args_.end() ) {
+    if( accumulate ) {
+        if( !getAll(id, separator, vec) )
+            return default_vals;
+    } else {
+        auto pos = findValue(id);
+        if( pos != args_.end() ) {
+            options_[id].separator = separator;
+            vec = split(*pos, separator);
+            args_.erase(pos);
+        }
+    }
 
-        if( pos+2  > args_.end() )
-            throw std::runtime_error("\nError: parameter --" + long_name + " is not followed by a value");
+    if (vec.empty())
+        return default_vals;
 
-        pos = args_.erase(pos);
-        val = *pos;
-        args_.erase(pos);
-
-        vec = split(val, separator);
-    }
-
-    // Then search the short names:
-    //
-    pos = findShortName(short_name);
-    if( pos != args_.end() ) {
-
-        if( pos+2 > args_.end() )
-            throw std::runtime_error("\nError: parameter -" + std::string(1,short_name) + " is not followed by a value");
-
-        if( pos->size() == 2 )
-            pos = args_.erase(pos);
-        else {
-            pos->erase(pos->find(short_name, 1), 1);
-            ++pos;
-        }
-        val = *pos;
-        vec = split(val, separator);
-    }
-
-    if (vec.empty())
-        return default_vals;
-
-    if ( enforce_default_size && vec.size() == 1 )
-        for( unsigned i=1; i<default_vals.size(); ++i)
-            vec.push_back(vec[0]);
+    if ( enforce_default_size && vec.size() == 1 )
+        for( unsigned i=1; i<default_vals.size(); ++i)
+            vec.push_back(vec[0]);
 
     if ( enforce_default_size && vec.size() != default_vals.size() ) {
-        std::ostringstream oss;
-        oss << "\nError: parameter --" << long_name;
-        if ( short_name != ' ' )
-            oss << " (-" << std::string(1,short_name) << ")";
-        oss << " is not followed by " << default_vals.size() << " values as expected.";
-        throw std::runtime_error(oss.str());
+        fail(ErrorCode::WrongNbValues, id, default_vals.size());
+        return default_vals;
     }
 
     return vec;
@@ -557,17 +1476,17 @@ std::vector<std::string> CmdLineArgs::getParams(const std::string &long_name, ch
 
 std::vector<std::string> CmdLineArgs::getParams(const std::string &long_name,
                                                 const std::vector<std::string> &default_vals, bool enforce_default_size,
-                                                const std::string &desc, char separator)
+                                                const std::string &desc, char separator, bool accumulate)
 {
-    return getParams(long_name, ' ', default_vals, enforce_default_size, desc, separator);
+    return getParams(long_name, ' ', default_vals, enforce_default_size, desc, separator, accumulate);
 }
 
 /// @endcond
 
 
-// Add some usage for a flag or parameter
+// Add some usage for a flag or parameter, and return the index of the option
 //
-void CmdLineArgs::addUsage(const std::string &long_name, char short_name, const std::string &default_val, const std::string &desc)
+int CmdLineArgs::addUsage(const std::string &long_name, char short_name, const std::string &default_val, const std::string &desc)
 {
     std::string usage(4,' ');
     usage += "--" + long_name;
@@ -582,6 +1501,13 @@ void CmdLineArgs::addUsage(const std::string &long_name, char short_name, const
         usage += " (default: " + default_val + ")";
 
     usage_.push_back( std::pair<std::string, std::string>(usage,desc) );
+    usage_valid_ = false;
+
+    options_.push_back(Option{long_name, short_name, 0, std::string(), '\0'});
+    ids_.insert(std::make_pair(long_name, int(options_.size()-1)));
+    present_.resize((options_.size()+63)/64);
+    next_option_ = options_.size();
+    return options_.size()-1;
 }
 
 
@@ -591,7 +1517,11 @@ void CmdLineArgs::addUsage(const std::string &long_name, char short_name, const
  */
 void CmdLineArgs::addUsageSeparator(const std::string &desc)
 {
+    if( compiled_ )
+        return;
+
     usage_.push_back(std::pair<std::string, std::string>("SEP", desc));
+    usage_valid_ = false;
 }
 
 
@@ -601,15 +1531,84 @@ void CmdLineArgs::addUsageSeparator(const std::string &desc)
  */
 void CmdLineArgs::addUsageOutro(const std::string &str)
 {
+    if( compiled_ )
+        return;
+
     usage_outro_ += str;
+    usage_valid_ = false;
 }
 
 
 /**
    @brief To get a nicely formatted usage.
    @return the usage string
+   @note The usage is rendered once and kept until an option, separator or outro is added.
+ */
+const std::string& CmdLineArgs::usage()
+{
+    if( !usage_valid_ ) {
+        usage_cache_.clear();
+        renderUsage(usage_cache_);
+        usage_valid_ = true;
+    }
+
+    return usage_cache_;
+}
+
+
+/**
+   @brief To write the nicely formatted usage to a stream.
+   @param os the stream receiving the usage.
+ */
+void CmdLineArgs::usage(std::ostream &os)
+{
+    const std::string &str = usage();
+    os.write(str.data(), str.size());
+}
+
+
+/**
+   @brief To wrap the descriptions of the options so that the usage fits in a given width.
+   @param width the number of columns available. 0 (the default) disables the wrapping.
+   @note Words longer than the available space are never broken. Use terminalWidth() to fit the terminal.
  */
-std::string CmdLineArgs::usage()
+void CmdLineArgs::setUsageWidth(int width)
+{
+    std::string::size_type new_width = width > 0 ? width : 0;
+    if( new_width != usage_width_ ) {
+        usage_width_ = new_width;
+        usage_valid_ = false;
+    }
+}
+
+
+/**
+   @brief To get the width of the terminal.
+   @return the number of columns of the terminal attached to stdout, or else the value of the
+   COLUMNS environment variable, or 0 if unknown.
+ */
+int CmdLineArgs::terminalWidth()
+{
+#if defined(__unix__) || defined(__APPLE__)
+    struct winsize ws;
+    if( isatty(STDOUT_FILENO) && ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0 )
+        return ws.ws_col;
+#endif
+
+    const char *columns = std::getenv("COLUMNS");
+    if( columns ) {
+        int width = std::atoi(columns);
+        if( width > 0 )
+            return width;
+    }
+
+    return 0;
+}
+
+
+// Render the usage into out. The size is computed first so that out is allocated only once.
+//
+void CmdLineArgs::renderUsage(std::string &out) const
 {
     // First find the maxim size of the arguments names:
     std::string::size_type left_size=0;
@@ -618,30 +1617,89 @@ std::string CmdLineArgs::usage()
     }
     left_size += 5;
 
-    std::string usage(usage_intro_ + "\n");
+    // The constraints, to add to the descriptions of the options:
+    std::vector<std::string> notes = constraintNotes();
+
+    // Then the total size. (Wrapping adds at most one indented line per wrapped word)
+    std::string::size_type total = usage_intro_.size() + 1 + usage_outro_.size();
+    int id = 0;
+    for( auto pos=usage_.begin(); pos!=usage_.end(); ++pos ) {
+        if(pos->first == "SEP") {
+            total += pos->second.size() + 1;
+        } else {
+            std::string::size_type nb_lines = std::count(pos->second.begin(), pos->second.end(), '\n');
+            if( usage_width_ ) {
+                nb_lines += std::count(pos->second.begin(), pos->second.end(), ' ');
+                nb_lines += std::count(notes[id].begin(), notes[id].end(), ' ');
+            }
+            total += left_size + pos->second.size() + notes[id].size() + nb_lines*left_size + 1;
+            ++id;
+        }
+    }
+    out.reserve(out.size() + total);
+
+    out += usage_intro_;
+    out += '\n';
+    id = 0;
     for( auto pos=usage_.begin(); pos!=usage_.end(); ++pos ) {
 
         if(pos->first == "SEP"){
-            usage += pos->second;
-            usage += "\n";
+            out += pos->second;
+            out += '\n';
         }else{
-            usage += pos->first;
+            out += pos->first;
             if(pos->first.size()<left_size)
-                usage += std::string(left_size-pos->first.size(),' ');
-            std::string right(pos->second);
-            std::string::size_type idx=0;
-            while( (idx = right.find('\n',idx)) != std::string::npos){
-                right.insert(idx+1,std::string(left_size,' '));
-                idx += left_size;
-            }
-            usage += right;
-            usage += '\n';
+                out.append(left_size-pos->first.size(),' ');
+            if( notes[id].empty() )
+                appendWrapped(out, pos->second, left_size);
+            else
+                appendWrapped(out, pos->second + notes[id], left_size);
+            out += '\n';
+            ++id;
         }
     }
 
-    usage += usage_outro_;
+    out += usage_outro_;
+}
+
 
-    return usage;
+// Append a description, indenting every new line by left_size and wrapping it to the usage width.
+//
+void CmdLineArgs::appendWrapped(std::string &out, const std::string &desc, std::string::size_type left_size) const
+{
+    // Not wrapped when there is not a minimum of room on the right:
+    std::string::size_type room = 0;
+    if( usage_width_ > left_size + 10 )
+        room = usage_width_ - left_size;
+
+    std::string::size_type begin = 0;
+    while( begin <= desc.size() ) {
+
+        std::string::size_type end = desc.find('\n', begin);
+        if( end == std::string::npos )
+            end = desc.size();
+
+        while( room && end-begin > room ) {
+            std::string::size_type cut = desc.rfind(' ', begin+room);
+            if( cut == std::string::npos || cut <= begin ) {
+                cut = desc.find(' ', begin+room);
+                if( cut == std::string::npos || cut >= end )
+                    break;
+            }
+            out.append(desc, begin, cut-begin);
+            out += '\n';
+            out.append(left_size, ' ');
+            begin = cut+1;
+        }
+
+        out.append(desc, begin, end-begin);
+        if( end == desc.size() )
+            break;
+
+        out += '\n';
+        out.append(left_size, ' ');
+        begin = end+1;
+    }
 }
 
 
@@ -671,30 +1729,26 @@ std::vector<std::string> CmdLineArgs::getUnparsedOpts()
 
 /**
    @brief To throw an exception if there are some remaining arguments on the command line.
+   @note When collecting errors, the error is recorded instead.
  */
 void CmdLineArgs::throwIfRemaining()
 {
-    if(!args_.empty()) {
-        std::string msg("\nError: remaining args: ");
-        for( auto &arg: args_ )
-            msg += arg + " ";
-        throw std::runtime_error(msg);
-    }
+    if(!args_.empty())
+        fail(ErrorCode::Remaining, 0);
 }
 
 
 /**
    @brief To throw an exception if there are some unparsed options on the command line.
+   @note When collecting errors, the error is recorded instead.
  */
 void CmdLineArgs::throwIfUnparsed()
 {
-    std::vector<std::string> unparsed = getUnparsedOpts();
-    if( !unparsed.empty() ) {
-        std::string msg("\nError: unparsed options: ");
-        for( auto &arg: unparsed )
-            msg += arg + " ";
-        throw std::runtime_error(msg);
-    }
+    for( unsigned i=0; i<args_.size(); ++i )
+        if( args_[i][0] == '-' ) {
+            fail(ErrorCode::Unparsed, i);
+            return;
+        }
 }
 
 
@@ -713,3 +1767,1726 @@ bool CmdLineArgs::isPresent(const std::string &long_name, char short_name)
     return pos_long != args_.end() || pos_short != args_.end() ;
 }
 
+
+
+
+/**
+   @brief Tells if a parameter or flag was present on the command line, once retrieved with getParam, getFlag...
+   @param long_name the long name of the parameter or flag.
+   @return true if it was present.
+ */
+bool CmdLineArgs::wasPresent(const std::string &long_name) const
+{
+    int id = findId(long_name);
+    return id >= 0 && isSet(id);
+}
+
+
+/**
+   @brief To constrain the values of a numerical parameter.
+   @param long_name the long name of the parameter.
+   @param min the minimal value.
+   @param max the maximal value.
+   @note As for all the constraints, it is checked by checkConstraints() and shown in the usage.
+   For a parameter with multiple values, each of them is checked.
+ */
+void CmdLineArgs::addRange(const std::string &long_name, double min, double max)
+{
+    if( compiled_ )
+        return;
+
+    Constraint constraint;
+    constraint.error = ErrorCode::OutOfRange;
+    constraint.names.push_back(long_name);
+    constraint.min = min;
+    constraint.max = max;
+    constraints_.push_back(std::move(constraint));
+    usage_valid_ = false;
+}
+
+
+/**
+   @brief To constrain the values of a parameter to a set of choices.
+   @param long_name the long name of the parameter.
+   @param choices the allowed values.
+ */
+void CmdLineArgs::addChoices(const std::string &long_name, const std::vector<std::string> &choices)
+{
+    if( compiled_ )
+        return;
+
+    Constraint constraint;
+    constraint.error = ErrorCode::InvalidChoice;
+    constraint.names.push_back(long_name);
+    constraint.choices = choices;
+    constraint.choices_set.insert(choices.begin(), choices.end());
+    constraints_.push_back(std::move(constraint));
+    usage_valid_ = false;
+}
+
+
+/**
+   @brief To make options mutually exclusive: at most one of them can be present.
+   @param long_names the long names of the options.
+ */
+void CmdLineArgs::addExclusive(const std::vector<std::string> &long_names)
+{
+    if( compiled_ )
+        return;
+
+    Constraint constraint;
+    constraint.error = ErrorCode::Exclusive;
+    constraint.names = long_names;
+    constraints_.push_back(std::move(constraint));
+    usage_valid_ = false;
+}
+
+
+/**
+   @brief To make an option require another one.
+   @param long_name the long name of the option.
+   @param required the long name of the option which must be present when long_name is.
+ */
+void CmdLineArgs::addRequires(const std::string &long_name, const std::string &required)
+{
+    if( compiled_ )
+        return;
+
+    Constraint constraint;
+    constraint.error = ErrorCode::MissingRequired;
+    constraint.names.push_back(long_name);
+    constraint.names.push_back(required);
+    constraints_.push_back(std::move(constraint));
+    usage_valid_ = false;
+}
+
+
+/**
+   @brief To check all the constraints, in a single pass, once the options are retrieved.
+   Constraints on options which were not retrieved are ignored.
+   @throw runtime_error at the first constraint not met, unless collecting the errors.
+ */
+void CmdLineArgs::checkConstraints()
+{
+    for( auto &constraint: constraints_ ) {
+
+        if( constraint.error == ErrorCode::Exclusive ) {
+            int first = -1;
+            for( auto &name: constraint.names ) {
+                int id = findId(name);
+                if( id < 0 || !isSet(id) )
+                    continue;
+                if( first < 0 )
+                    first = id;
+                else
+                    fail(ErrorCode::Exclusive, id, 0, first);
+            }
+            continue;
+        }
+
+        int id = findId(constraint.names[0]);
+        if( id < 0 || !isSet(id) )
+            continue;
+
+        if( constraint.error == ErrorCode::MissingRequired ) {
+            int required = findId(constraint.names[1]);
+            if( required >= 0 && !isSet(required) )
+                fail(ErrorCode::MissingRequired, id, 0, required);
+
+        } else if( !checkValue(constraint, options_[id].value, options_[id].separator) )
+            fail(constraint.error, id);
+    }
+}
+
+
+// To check the values of a parameter against a range or choices constraint.
+// The value is split at the separator of a parameter with several values, and checked as a whole otherwise.
+//
+bool CmdLineArgs::checkValue(const Constraint &constraint, const std::string &value, char separator) const
+{
+    std::string item;
+    std::string::size_type begin = 0;
+
+    while( begin <= value.size() ) {
+        std::string::size_type end = separator ? value.find(separator, begin) : std::string::npos;
+        if( end == std::string::npos )
+            end = value.size();
+        item.assign(value, begin, end-begin);
+        begin = end+1;
+
+        if( constraint.error == ErrorCode::InvalidChoice ) {
+            if( !constraint.choices_set.count(item) )
+                return false;
+            continue;
+        }
+
+        double val;
+        long long ival;
+        if( convert(item, val) ) {
+            if( val < constraint.min || val > constraint.max )
+                return false;
+        } else if( convert(item, ival) ) {
+            if( ival < constraint.min || ival > constraint.max )
+                return false;
+        } else
+            return false;
+    }
+
+    return true;
+}
+
+
+// The constraints of each option, as they appear in the usage
+//
+std::vector<std::string> CmdLineArgs::constraintNotes() const
+{
+    std::vector<std::string> notes(options_.size());
+
+    for( auto &constraint: constraints_ ) {
+        int id = findId(constraint.names[0]);
+
+        switch( constraint.error ) {
+        case ErrorCode::OutOfRange: {
+            if( id < 0 )
+                break;
+            std::ostringstream oss;
+            oss << " [" << constraint.min << " to " << constraint.max << "]";
+            notes[id] += oss.str();
+            break;
+        }
+        case ErrorCode::InvalidChoice:
+            if( id < 0 )
+                break;
+            notes[id] += " [one of:";
+            for( auto &choice: constraint.choices )
+                notes[id] += " " + choice;
+            notes[id] += "]";
+            break;
+        case ErrorCode::MissingRequired:
+            if( id >= 0 )
+                notes[id] += " [requires --" + constraint.names[1] + "]";
+            break;
+        default:
+            for( auto &name: constraint.names ) {
+                id = findId(name);
+                if( id < 0 )
+                    continue;
+                notes[id] += " [excludes";
+                for( auto &other: constraint.names )
+                    if( other != name )
+                        notes[id] += " --" + other;
+                notes[id] += "]";
+            }
+            break;
+        }
+    }
+
+    return notes;
+}
+
+
+// To record that an option was found
+//
+void CmdLineArgs::setPresent(int id)
+{
+    present_[id/64] |= uint64_t(1) << (id%64);
+}
+
+
+// Tells if an option was found
+//
+bool CmdLineArgs::isSet(int id) const
+{
+    return (present_[id/64] >> (id%64)) & 1;
+}
+
+
+// The index of an option from its long name, or -1
+//
+int CmdLineArgs::findId(const std::string &long_name) const
+{
+    auto pos = ids_.find(long_name);
+    return pos != ids_.end() ? pos->second : -1;
+}
+
+
+/**
+   @brief To collect the parsing errors instead of throwing an exception at the first one.
+   @param collect When true, the errors are recorded and the parsing goes on. A parameter with an error gets its
+   default value. The errors can then be retrieved with errors() or thrown with throwIfErrors().
+   When false (the default), a runtime_error is thrown at the first error.
+ */
+void CmdLineArgs::collectErrors(bool collect)
+{
+    collect_errors_ = collect;
+}
+
+
+/**
+   @brief To get the errors collected so far.
+   @return the errors, in the order they occurred.
+ */
+const std::vector<CmdLineArgs::Error>& CmdLineArgs::errors() const
+{
+    return errors_;
+}
+
+
+/**
+   @brief To get the message describing an error.
+   @param error the error to describe.
+   @return the message, the same as the one of the exception thrown when not collecting the errors.
+ */
+std::string CmdLineArgs::errorMessage(const Error &error) const
+{
+    std::string msg("\nError: ");
+
+    if( error.code == ErrorCode::Remaining || error.code == ErrorCode::Unparsed ) {
+        bool unparsed = error.code == ErrorCode::Unparsed;
+        msg += unparsed ? "unparsed options: " : "remaining args: ";
+        for( auto &arg: args_ )
+            if( !unparsed || arg[0] == '-' )
+                msg += arg + " ";
+        return msg;
+    }
+
+    if( error.code == ErrorCode::UnterminatedQuote )
+        return msg + "unterminated quote in the command line";
+
+    const Option &opt = options_[error.option];
+    msg += "parameter --" + opt.long_name;
+    if( opt.short_name != ' ' )
+        msg += " (-" + std::string(1,opt.short_name) + ")";
+
+    switch( error.code ) {
+    case ErrorCode::MissingValue:
+        msg += " is not followed by a value";
+        break;
+    case ErrorCode::IncorrectValue:
+        msg += " is not followed by a correct value";
+        break;
+    case ErrorCode::OutOfRange:
+        msg += " is out of range";
+        break;
+    case ErrorCode::InvalidChoice:
+        msg += " is not one of the allowed values";
+        break;
+    case ErrorCode::Exclusive:
+        msg += " cannot be used with --" + options_[error.other].long_name;
+        break;
+    case ErrorCode::MissingRequired:
+        msg += " requires --" + options_[error.other].long_name;
+        break;
+    case ErrorCode::DuplicateKey:
+        msg += " is given a key twice";
+        break;
+    default:
+        msg += " is not followed by " + std::to_string(error.nb_expected) + " values as expected.";
+        break;
+    }
+
+    return msg;
+}
+
+
+/**
+   @brief To throw an exception if some errors were collected.
+   The message of the exception gathers the messages of all the errors.
+ */
+void CmdLineArgs::throwIfErrors() const
+{
+    if( !errors_.empty() ) {
+        std::string msg;
+        for( auto &error: errors_ )
+            msg += errorMessage(error);
+        throw std::runtime_error(msg);
+    }
+}
+
+
+// Record an error, or throw it when not collecting the errors.
+//
+void CmdLineArgs::fail(ErrorCode code, int option, unsigned nb_expected, int other)
+{
+    Error error = {code, option, nb_expected, other};
+
+    if( !collect_errors_ )
+        throw std::runtime_error(errorMessage(error));
+
+    errors_.push_back(error);
+}
+
+
+
+/**
+   @brief To save the result of the parsing into a binary image, so that it can be used by CmdLineArgs::Snapshot.
+   It contains the options retrieved so far with their values, and the remaining arguments.
+   @return the image.
+ */
+std::string CmdLineArgs::snapshot() const
+{
+    typedef Snapshot::Header Header;
+    typedef Snapshot::Entry Entry;
+
+    // The strings come after the header and the tables, and are aligned so that the next image is aligned too:
+    std::string::size_type strings = sizeof(Header) + options_.size()*sizeof(Entry) + args_.size()*sizeof(uint32_t);
+    std::string::size_type size = strings;
+    for( auto &opt: options_ )
+        size += opt.long_name.size() + 1 + (opt.count ? opt.value.size() + 1 : 0);
+    for( auto &arg: args_ )
+        size += arg.size() + 1;
+    size = (size + 7) & ~std::string::size_type(7);
+
+    std::string image(size, '\0');
+    char *data = &image[0];
+
+    Header header = { Snapshot::magic, Snapshot::version, uint32_t(size), 0, uint32_t(options_.size()), uint32_t(args_.size()) };
+
+    std::string::size_type off = strings;
+    auto addString = [data, &off](const std::string &str) {
+        uint32_t pos = off;
+        std::memcpy(data+off, str.c_str(), str.size()+1);
+        off += str.size()+1;
+        return pos;
+    };
+
+    char *table = data + sizeof(Header);
+    for( auto &opt: options_ ) {
+        Entry entry = { addString(opt.long_name), 0, opt.count };
+        if( opt.count )
+            entry.value = addString(opt.value);
+        std::memcpy(table, &entry, sizeof(Entry));
+        table += sizeof(Entry);
+    }
+    for( auto &arg: args_ ) {
+        uint32_t pos = addString(arg);
+        std::memcpy(table, &pos, sizeof(pos));
+        table += sizeof(pos);
+    }
+
+    header.checksum = checksum(data + sizeof(Header), size - sizeof(Header));
+    std::memcpy(data, &header, sizeof(Header));
+
+    return image;
+}
+
+
+/**
+   @brief To save the result of the parsing into an anonymous shared memory file.
+   The file is sealed against any modification. Forked processes inherit it, and it can be passed to spawned
+   processes (for instance by its number on their command line) which get it with CmdLineArgs::Snapshot::map().
+   @return the file descriptor. The caller must close it.
+   @throw runtime_error if the file cannot be created. (Only supported on Linux)
+ */
+int CmdLineArgs::snapshotFd() const
+{
+#if defined(__linux__) && defined(MFD_ALLOW_SEALING)
+    std::string image = snapshot();
+
+    int fd = memfd_create("CmdLineArgs", MFD_ALLOW_SEALING);
+    if( fd >= 0 ) {
+        std::string::size_type done = 0;
+        while( done < image.size() ) {
+            ssize_t nb = write(fd, image.data() + done, image.size() - done);
+            if( nb <= 0 )
+                break;
+            done += nb;
+        }
+
+        if( done == image.size() && fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) == 0 )
+            return fd;
+
+        close(fd);
+    }
+#endif
+
+    throw std::runtime_error("\nError: cannot create the snapshot file");
+}
+
+
+// FNV-1a hash, to check the images
+//
+uint32_t CmdLineArgs::checksum(const char *data, std::string::size_type size)
+{
+    uint32_t hash = 2166136261u;
+    for( std::string::size_type i=0; i<size; ++i ) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+
+/**
+   @brief Constructor, from an image made by CmdLineArgs::snapshot(). The image is not copied.
+   @param data the image, aligned on 8 bytes.
+   @param size the size of the image.
+   @throw runtime_error if the image is corrupted or was made by another version of CmdLineArgs.
+ */
+CmdLineArgs::Snapshot::Snapshot(const void *data, std::size_t size)
+    :data_(static_cast<const char*>(data)), map_size_(0)
+{
+    bool ok = size >= sizeof(Header) && reinterpret_cast<std::uintptr_t>(data_) % alignof(Header) == 0;
+    if( ok ) {
+        const Header &head = header();
+        ok = head.magic == magic && head.version == version && head.size <= size
+             && (head.size - sizeof(Header)) / sizeof(Entry) >= head.nb_options
+             && sizeof(Header) + head.nb_options*uint64_t(sizeof(Entry)) + head.nb_args*uint64_t(sizeof(uint32_t)) <= head.size
+             && checksum(data_ + sizeof(Header), head.size - sizeof(Header)) == head.checksum;
+    }
+
+    if( !ok )
+        throw std::runtime_error("\nError: invalid or stale snapshot of the command line");
+}
+
+
+/**
+   @brief To map read-only an image saved in a file, typically made by CmdLineArgs::snapshotFd().
+   @param fd the file descriptor. It can be closed once mapped.
+   @return the snapshot, which unmaps the image when destroyed.
+   @throw runtime_error if the file cannot be mapped or is not a valid image.
+ */
+CmdLineArgs::Snapshot CmdLineArgs::Snapshot::map(int fd)
+{
+#if defined(__unix__) || defined(__APPLE__)
+    struct stat st;
+    if( fstat(fd, &st) == 0 && st.st_size > 0 ) {
+        void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if( data != MAP_FAILED ) {
+            try {
+                Snapshot snapshot(data, st.st_size);
+                snapshot.map_size_ = st.st_size;
+                return snapshot;
+            } catch (...) {
+                munmap(data, st.st_size);
+                throw;
+            }
+        }
+    }
+#endif
+
+    throw std::runtime_error("\nError: cannot map the snapshot of the command line");
+}
+
+
+CmdLineArgs::Snapshot::Snapshot(Snapshot &&other)
+    :data_(other.data_), map_size_(other.map_size_)
+{
+    other.map_size_ = 0;
+}
+
+
+CmdLineArgs::Snapshot::~Snapshot()
+{
+#if defined(__unix__) || defined(__APPLE__)
+    if( map_size_ )
+        munmap(const_cast<char*>(data_), map_size_);
+#endif
+}
+
+
+// To find the entry of an option
+//
+const CmdLineArgs::Snapshot::Entry* CmdLineArgs::Snapshot::find(const std::string &long_name) const
+{
+    const Entry *entry = entries();
+    for( uint32_t i=0; i<header().nb_options; ++i, ++entry )
+        if( long_name == data_ + entry->name )
+            return entry;
+
+    return nullptr;
+}
+
+
+/**
+   @brief Tells if an option was present on the command line.
+   @param long_name the long name of the option.
+   @return true if it was present.
+ */
+bool CmdLineArgs::Snapshot::isPresent(const std::string &long_name) const
+{
+    return getFlag(long_name) > 0;
+}
+
+
+/**
+   @brief To get the number of times a flag was present.
+   @param long_name the long name of the flag.
+   @return the number of times the flag is present.
+ */
+int CmdLineArgs::Snapshot::getFlag(const std::string &long_name) const
+{
+    const Entry *entry = find(long_name);
+    return entry ? entry->count : 0;
+}
+
+
+/**
+   @brief To get the value of a parameter, as it was given on the command line.
+   @param long_name the long name of the parameter.
+   @return the value, pointing into the image, or nullptr if the parameter was not present. (It is empty for a flag)
+ */
+const char* CmdLineArgs::Snapshot::getValue(const std::string &long_name) const
+{
+    const Entry *entry = find(long_name);
+    return entry && entry->value ? data_ + entry->value : nullptr;
+}
+
+
+/**
+   @brief To get the value of a parameter.
+   @param long_name the long name of the parameter.
+   @param default_value the value to give if the parameter was not present or has not a correct value.
+   @return the value of the parameter.
+ */
+template <class T>
+T CmdLineArgs::Snapshot::getParam(const std::string &long_name, T default_value) const
+{
+    const char *value = getValue(long_name);
+    T val;
+    if( value && CmdLineArgs::convert(value, val) )
+        return val;
+
+    return default_value;
+}
+
+
+/// @cond SPECIALISATIONS
+std::string CmdLineArgs::Snapshot::getParam(const std::string &long_name, const char *default_value) const
+{
+    const char *value = getValue(long_name);
+    return value ? value : default_value;
+}
+/// @endcond
+
+
+/**
+   @brief To get the number of remaining arguments.
+ */
+unsigned CmdLineArgs::Snapshot::nbRemaining() const
+{
+    return header().nb_args;
+}
+
+
+/**
+   @brief To get a remaining argument.
+   @param i the index of the argument, less than nbRemaining().
+   @return the argument, pointing into the image.
+ */
+const char* CmdLineArgs::Snapshot::getRemaining(unsigned i) const
+{
+    return data_ + args()[i];
+}
+
+
+
+/**
+   @brief Constructor, from a list of ranges.
+   @param str the ranges, such as "0-15,32-47" or "0-65535:4".
+   @throw runtime_error if the list is not correct.
+ */
+CmdLineArgs::RangeSet::RangeSet(const std::string &str)
+{
+    if( !parse(str, *this) )
+        throw std::runtime_error("\nError: incorrect list of ranges: " + str);
+}
+
+
+/**
+   @brief To parse a list of ranges.
+   @param str the ranges, separated by commas. Each is a value "N", a range "A-B" or a range with a stride "A-B:S".
+   @param set the set receiving the ranges.
+   @return false if the list is not correct.
+ */
+bool CmdLineArgs::RangeSet::parse(const std::string &str, RangeSet &set)
+{
+    std::vector<Range> ranges;
+    const char *pos = str.c_str();
+
+    while( *pos ) {
+        Range range;
+        if( !parseValue(pos, range.first) )
+            return false;
+        range.last = range.first;
+        range.step = 1;
+
+        if( *pos == '-' ) {
+            if( !parseValue(++pos, range.last) )
+                return false;
+
+            if( *pos == ':' && !parseValue(++pos, range.step) )
+                return false;
+        }
+
+        if( range.last < range.first || range.step <= 0 )
+            return false;
+        range.last -= (uint64_t(range.last) - uint64_t(range.first)) % range.step;
+        ranges.push_back(range);
+
+        if( *pos == ',' && pos[1] )
+            ++pos;
+        else if( *pos )
+            return false;
+    }
+
+    // Sort the ranges, and merge the contiguous ones:
+    std::sort(ranges.begin(), ranges.end(), [](const Range &a, const Range &b){ return a.first < b.first; });
+
+    set.ranges_.clear();
+    for( auto &range: ranges ) {
+        if( !set.ranges_.empty() ) {
+            Range &prev = set.ranges_.back();
+            bool single = range.first == range.last;
+            if( prev.step == 1 && (range.step == 1 || single) && (range.first <= prev.last || range.first - 1 == prev.last) ) {
+                prev.last = std::max(prev.last, range.last);
+                continue;
+            }
+            if( single && range.first >= prev.first && range.first <= prev.last
+                && (uint64_t(range.first) - uint64_t(prev.first)) % prev.step == 0 )
+                continue;
+        }
+        set.ranges_.push_back(range);
+    }
+
+    set.normalize();
+    return true;
+}
+
+
+// To compute the blocks of values from the ranges.
+// The ranges are cut at all their bounds. Between two bounds, the ranges covering the interval repeat with a period
+// which is the least common multiple of their steps, (or the length of the interval if shorter) so the union of their
+// values is a block made of the offsets of a single period. When the period has too many offsets, as for large
+// coprime steps, the block keeps the ranges instead.
+//
+void CmdLineArgs::RangeSet::normalize()
+{
+    blocks_.clear();
+    offsets_.clear();
+    strided_.clear();
+
+    std::vector<long long> bounds;
+    for( auto &range: ranges_ ) {
+        bounds.push_back(range.first);
+        if( range.last < LLONG_MAX )
+            bounds.push_back(range.last + 1);
+    }
+    std::sort(bounds.begin(), bounds.end());
+    bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+
+    std::vector<Range> covering;
+    std::vector<long long> offsets;
+    for( std::size_t i=0; i<bounds.size(); ++i ) {
+        long long first = bounds[i];
+        long long last = i+1 < bounds.size() ? bounds[i+1] - 1 : LLONG_MAX;
+        uint64_t span = uint64_t(last) - uint64_t(first);
+        long long length = span < uint64_t(LLONG_MAX) ? last - first + 1 : LLONG_MAX;
+
+        // The ranges covering [first, last], from their first value in it:
+        covering.clear();
+        for( auto &range: ranges_ ) {
+            if( range.first > first )
+                break;
+            if( range.last < last )
+                continue;
+            uint64_t o = (range.step - (uint64_t(first) - uint64_t(range.first)) % range.step) % range.step;
+            if( o <= span )
+                covering.push_back(Range{ (long long)(uint64_t(first) + o), last, range.step });
+        }
+
+        // Without those included in another one:
+        std::size_t nb = 0;
+        for( std::size_t j=0; j<covering.size(); ++j ) {
+            bool included = false;
+            for( std::size_t k=0; k<covering.size() && !included; ++k ) {
+                const Range &a = covering[j], &b = covering[k];
+                included = k != j && a.step % b.step == 0 && a.first >= b.first
+                           && (uint64_t(a.first) - uint64_t(b.first)) % b.step == 0
+                           && (a.first != b.first || a.step != b.step || k < j);
+            }
+            if( !included )
+                covering[nb++] = covering[j];
+        }
+        covering.resize(nb);
+        if( covering.empty() )
+            continue;
+
+        // The period of the ranges, and the number of offsets in it:
+        long long period = 1;
+        for( auto &range: covering ) {
+            long long a = gcd(period, range.step);
+            period = period / a > length / range.step ? length : period / a * range.step;
+            period = std::min(period, length);
+        }
+        uint64_t nb_offsets = 0;
+        for( auto &range: covering )
+            nb_offsets += period / range.step + 1;
+
+        if( nb_offsets > max_offsets * covering.size() ) {
+            Block block = { covering[0].first, last, 0, strided_.size(), covering.size() };
+            for( auto &range: covering ) {
+                block.first = std::min(block.first, range.first);
+                strided_.push_back(range);
+            }
+            blocks_.push_back(block);
+            continue;
+        }
+
+        // The offsets of their values in a period:
+        offsets.clear();
+        for( auto &range: covering )
+            for( long long o = range.first - first; o < period; o += range.step )
+                offsets.push_back(o);
+        std::sort(offsets.begin(), offsets.end());
+        offsets.erase(std::unique(offsets.begin(), offsets.end()), offsets.end());
+
+        Block block = { first + offsets[0], last, period, offsets_.size(), offsets.size() };
+        for( auto o: offsets )
+            offsets_.push_back(o - offsets[0]);
+
+        // Evenly spaced offsets make a simple step:
+        if( offsets.size() > 1 && period % offsets.size() == 0 ) {
+            long long step = period / offsets.size();
+            bool even = true;
+            for( std::size_t j=0; even && j<offsets.size(); ++j )
+                even = offsets_[block.offset + j] == (long long)j * step;
+            if( even ) {
+                offsets_.resize(block.offset + 1);
+                block.period = step;
+                block.nb_offsets = 1;
+            }
+        }
+
+        // Merged with the previous block when it continues it:
+        if( !blocks_.empty() && block.nb_offsets == 1 ) {
+            Block &prev = blocks_.back();
+            uint64_t prev_span = uint64_t(prev.last) - uint64_t(prev.first);
+            if( prev.nb_offsets == 1 && prev.period == block.period
+                && prev_span / prev.period * prev.period + prev.period == uint64_t(block.first) - uint64_t(prev.first) ) {
+                prev.last = block.last;
+                offsets_.resize(block.offset);
+                continue;
+            }
+        }
+
+        blocks_.push_back(block);
+    }
+}
+
+
+// To move to the next value of a block, base being the start of the period, or the value for a block without period.
+// Returns false at the end of the block.
+//
+bool CmdLineArgs::RangeSet::next(const Block &block, long long &base, std::size_t &pos) const
+{
+    if( block.period ) {
+        if( ++pos == block.nb_offsets ) {
+            pos = 0;
+            if( uint64_t(block.last) - uint64_t(base) < uint64_t(block.period) )
+                return false;
+            base += block.period;
+        }
+        return uint64_t(block.last) - uint64_t(base) >= uint64_t(offsets_[block.offset + pos]);
+    }
+
+    // The smallest value of the ranges after base:
+    bool found = false;
+    long long value = 0;
+    for( std::size_t i=block.offset; i<block.offset+block.nb_offsets; ++i ) {
+        const Range &range = strided_[i];
+        long long v = range.first;
+        if( v <= base ) {
+            uint64_t k = (uint64_t(base) - uint64_t(range.first)) / range.step + 1;
+            if( k > (uint64_t(range.last) - uint64_t(range.first)) / range.step )
+                continue;
+            v = (long long)(uint64_t(range.first) + k * range.step);
+        }
+        if( !found || v < value ) {
+            value = v;
+            found = true;
+        }
+    }
+
+    base = value;
+    return found;
+}
+
+
+// The number of values x + k*step up to last which are in one of the ranges, (x alone when step is 0) these values
+// being relative to origin. By inclusion-exclusion: |P & (R1 | R2...)| = |P & R1| + |P & (R2...)| - |P & R1 & (R2...)|
+//
+uint64_t CmdLineArgs::RangeSet::countUnion(const Range *ranges, std::size_t nb, long long origin,
+                                           uint64_t x, uint64_t step, uint64_t last) const
+{
+    if( !step ) {
+        for( std::size_t i=0; i<nb; ++i ) {
+            uint64_t r = uint64_t(ranges[i].first) - uint64_t(origin);
+            if( x >= r && (x - r) % ranges[i].step == 0 )
+                return 1;
+        }
+        return 0;
+    }
+
+    if( !nb )
+        return 0;
+
+    uint64_t y, common;
+    if( !intersect(x, step, uint64_t(ranges->first) - uint64_t(origin), ranges->step, last, y, common) )
+        return countUnion(ranges+1, nb-1, origin, x, step, last);
+
+    uint64_t both = common ? (last - y) / common + 1 : 1;
+    if( y == x && common == step )
+        return both;
+
+    return both + countUnion(ranges+1, nb-1, origin, x, step, last) - countUnion(ranges+1, nb-1, origin, y, common, last);
+}
+
+
+// To get the values common to x + k*step and to r + k*s, up to last, as y + k*common. (y alone when common is 0)
+// r is the first value of its range from 0, and x is not before 0, so y is the first value not before x.
+// Returns false if there is none.
+//
+bool CmdLineArgs::RangeSet::intersect(uint64_t x, uint64_t step, uint64_t r, uint64_t s, uint64_t last,
+                                      uint64_t &y, uint64_t &common)
+{
+    // y = x + j*step with j*step = r - x modulo s:
+    uint64_t d = r >= x ? (r - x) % s : (s - (x - r) % s) % s;
+    uint64_t g = gcd(step, s);
+    if( d % g )
+        return false;
+
+    // j = (d/g) / (step/g) modulo s/g:
+    uint64_t m = s / g;
+    long long t = 0, new_t = 1, q;
+    uint64_t a = m, b = step / g % m;
+    while( b ) {
+        q = a / b;
+        std::swap(t, new_t);
+        new_t -= q * t;
+        a -= q * b;
+        std::swap(a, b);
+    }
+    uint64_t inverse = t < 0 ? uint64_t(t + (long long)m) : uint64_t(t);
+
+    uint64_t j = 0;
+    for( uint64_t f = d / g % m, e = inverse % m; e; e >>= 1 ) {
+        if( e & 1 )
+            j = (j + f) % m;
+        f = (f + f) % m;
+    }
+
+    if( j > (last - x) / step )
+        return false;
+
+    y = x + j * step;
+    common = step / g > (last - y) / s ? 0 : step / g * s;
+    return true;
+}
+
+
+uint64_t CmdLineArgs::RangeSet::gcd(uint64_t a, uint64_t b)
+{
+    while( b ) {
+        uint64_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+
+// To parse a value of a range, in decimal or hexadecimal
+//
+bool CmdLineArgs::RangeSet::parseValue(const char *&pos, long long &value)
+{
+    const char *digits = pos + (*pos == '-' || *pos == '+');
+    bool hex = digits[0] == '0' && (digits[1] == 'x' || digits[1] == 'X');
+
+    char *end;
+    value = std::strtoll(pos, &end, hex ? 16 : 10);
+    if( end == pos || std::isspace(static_cast<unsigned char>(*pos)) )
+        return false;
+
+    pos = end;
+    return true;
+}
+
+
+/**
+   @brief To get the number of values in the set.
+   @note The time does not depend on the number of values, but grows with the strided ranges overlapping each other.
+ */
+uint64_t CmdLineArgs::RangeSet::size() const
+{
+    uint64_t nb = 0;
+    for( auto &block: blocks_ ) {
+        uint64_t span = uint64_t(block.last) - uint64_t(block.first);
+        if( !block.period ) {
+            nb += countUnion(&strided_[block.offset], block.nb_offsets, block.first, 0, 1, span);
+            continue;
+        }
+        const long long *offsets = &offsets_[block.offset];
+        nb += span / block.period * block.nb_offsets;
+        nb += std::upper_bound(offsets, offsets + block.nb_offsets, (long long)(span % block.period)) - offsets;
+    }
+    return nb;
+}
+
+
+/**
+   @brief Tells if a value is in the set, in a time logarithmic in the number of ranges.
+   (and linear in the number of strided ranges overlapping at the value, when their period is too long)
+ */
+bool CmdLineArgs::RangeSet::contains(long long value) const
+{
+    auto pos = std::upper_bound(blocks_.begin(), blocks_.end(), value,
+                                [](long long v, const Block &block){ return v < block.first; });
+    if( pos == blocks_.begin() )
+        return false;
+
+    const Block &block = *--pos;
+    if( value > block.last )
+        return false;
+
+    if( !block.period ) {
+        for( std::size_t i=block.offset; i<block.offset+block.nb_offsets; ++i )
+            if( value >= strided_[i].first && (uint64_t(value) - uint64_t(strided_[i].first)) % strided_[i].step == 0 )
+                return true;
+        return false;
+    }
+
+    const long long *offsets = &offsets_[block.offset];
+    return std::binary_search(offsets, offsets + block.nb_offsets,
+                              (long long)((uint64_t(value) - uint64_t(block.first)) % block.period));
+}
+
+
+CmdLineArgs::RangeSet::const_iterator CmdLineArgs::RangeSet::begin() const
+{
+    return const_iterator(this, 0);
+}
+
+
+CmdLineArgs::RangeSet::const_iterator CmdLineArgs::RangeSet::end() const
+{
+    return const_iterator(this, blocks_.size());
+}
+
+
+/**
+   @brief To get a bitset with the bits of the values of the set. Values out of [0, N) are ignored.
+ */
+template <std::size_t N>
+std::bitset<N> CmdLineArgs::RangeSet::toBitset() const
+{
+    std::bitset<N> bits;
+    for( std::size_t v=0; v<N; ++v )
+        if( contains(v) )
+            bits.set(v);
+    return bits;
+}
+
+
+#if defined(__linux__) && defined(CPU_SETSIZE)
+/**
+   @brief To fill a cpu_set_t with the values of the set, for sched_setaffinity() or pthread_setaffinity_np().
+   Values out of [0, CPU_SETSIZE) are ignored.
+ */
+void CmdLineArgs::RangeSet::toCpuSet(cpu_set_t &cpus) const
+{
+    CPU_ZERO(&cpus);
+    for( int v=0; v<CPU_SETSIZE; ++v )
+        if( contains(v) )
+            CPU_SET(v, &cpus);
+}
+#endif
+
+
+/**
+   @brief To get the set as a list of ranges, as parsed.
+ */
+std::string CmdLineArgs::RangeSet::str() const
+{
+    std::string str;
+    for( auto &range: ranges_ ) {
+        if( !str.empty() )
+            str += ',';
+        str += std::to_string(range.first);
+        if( range.last != range.first ) {
+            str += '-';
+            str += std::to_string(range.last);
+            if( range.step != 1 )
+                str += ':' + std::to_string(range.step);
+        }
+    }
+    return str;
+}
+
+
+/// @cond SPECIALISATIONS
+// Stream operators, so that a RangeSet is a parameter as any other
+//
+std::ostream& operator<<(std::ostream &os, const CmdLineArgs::RangeSet &set)
+{
+    return os << set.str();
+}
+
+std::istream& operator>>(std::istream &is, CmdLineArgs::RangeSet &set)
+{
+    std::string str;
+    if( is >> str && !CmdLineArgs::RangeSet::parse(str, set) )
+        is.setstate(std::ios::failbit);
+    return is;
+}
+/// @endcond
+
+
+
+/**
+   @brief To get key=value pairs, from all the occurrences of a parameter.
+   Exple: "--define k1=v1 --define k2=v2,k3=v3" gives 3 pairs with ',' as separator.
+   @param long_name long name of the parameter (so starting with "--").
+   @param short_name short name of the parameter (so a single letter starting with "-").
+   @param desc A description of the parameter. (will go into the usage)
+   @param duplicates What to do when a key is given several times: keep the last or the first value, or refuse it
+   as an error.
+   @param separator the character used to separate several pairs given at once. '\0' for none.
+   @return the pairs, in an empty map if the parameter is not present.
+ */
+CmdLineArgs::Map CmdLineArgs::getMap(const std::string &long_name, char short_name, const std::string &desc,
+                                     Duplicates duplicates, char separator)
+{
+    int id = nextDefinedOption(long_name);
+    if( id < 0 )
+        id = addUsage(long_name, short_name, "", desc);
+
+    Map map(duplicates);
+    std::vector<std::string> pairs;
+    if( !getAll(id, separator, pairs) )
+        return map;
+
+    std::string key, value;
+    for( auto &pair: pairs ) {
+        std::string::size_type equal = pair.find('=');
+        if( equal == 0 || equal == std::string::npos ) {
+            fail(ErrorCode::IncorrectValue, id);
+            return Map(duplicates);
+        }
+
+        key.assign(pair, 0, equal);
+        value.assign(pair, equal+1, std::string::npos);
+        if( !map.insert(key, value) && duplicates == Duplicates::Refuse ) {
+            fail(ErrorCode::DuplicateKey, id);
+            return Map(duplicates);
+        }
+    }
+
+    return map;
+}
+
+
+/**
+   @brief To get key=value pairs, no short name.
+   @see getMap(const std::string&, char, const std::string&, Duplicates, char)
+ */
+CmdLineArgs::Map CmdLineArgs::getMap(const std::string &long_name, const std::string &desc,
+                                     Duplicates duplicates, char separator)
+{
+    return getMap(long_name, ' ', desc, duplicates, separator);
+}
+
+
+/**
+   @brief To add a pair to the map.
+   @param key the key.
+   @param value the value.
+   @return false if the key was already in the map. Its value is then replaced only with Duplicates::KeepLast.
+ */
+bool CmdLineArgs::Map::insert(const std::string &key, const std::string &value)
+{
+    if( (entries_.size()+1)*2 > slots_.size() )
+        grow();
+
+    uint32_t hash = CmdLineArgs::checksum(key.data(), key.size());
+    std::size_t slot = findSlot(key, hash);
+
+    if( slots_[slot] >= 0 ) {
+        if( duplicates_ == Duplicates::KeepLast )
+            entries_[slots_[slot]].value = store(value);
+        return false;
+    }
+
+    Entry entry;
+    entry.key = store(key);
+    entry.key_size = key.size();
+    entry.value = store(value);
+    entry.hash = hash;
+
+    slots_[slot] = entries_.size();
+    entries_.push_back(entry);
+    return true;
+}
+
+
+/**
+   @brief Tells if a key is in the map.
+ */
+bool CmdLineArgs::Map::contains(const std::string &key) const
+{
+    return get(key) != nullptr;
+}
+
+
+/**
+   @brief To get the value of a key.
+   @return the value, or nullptr if the key is not in the map.
+ */
+const char* CmdLineArgs::Map::get(const std::string &key) const
+{
+    if( slots_.empty() )
+        return nullptr;
+
+    int32_t idx = slots_[findSlot(key, CmdLineArgs::checksum(key.data(), key.size()))];
+    return idx >= 0 ? value(idx) : nullptr;
+}
+
+
+/**
+   @brief To get the value of a key, converted to the type of the default value.
+   @param key the key.
+   @param default_value the value to give if the key is not in the map, or if its value cannot be converted.
+ */
+template <class T>
+T CmdLineArgs::Map::get(const std::string &key, T default_value) const
+{
+    const char *val = get(key);
+    T converted;
+    if( val && CmdLineArgs::convert(val, converted) )
+        return converted;
+
+    return default_value;
+}
+
+
+/// @cond SPECIALISATIONS
+std::string CmdLineArgs::Map::get(const std::string &key, const char *default_value) const
+{
+    const char *val = get(key);
+    return val ? val : default_value;
+}
+/// @endcond
+
+
+// The slot of a key, or else the empty slot where to insert it
+//
+std::size_t CmdLineArgs::Map::findSlot(const std::string &key, uint32_t hash) const
+{
+    std::size_t mask = slots_.size()-1;
+    std::size_t slot = hash & mask;
+
+    while( slots_[slot] >= 0 ) {
+        const Entry &entry = entries_[slots_[slot]];
+        if( entry.hash == hash && entry.key_size == key.size() && key.compare(0, key.size(), buffer_.data()+entry.key, entry.key_size) == 0 )
+            return slot;
+        slot = (slot+1) & mask;
+    }
+
+    return slot;
+}
+
+
+// Double the size of the hash table
+//
+void CmdLineArgs::Map::grow()
+{
+    slots_.assign(slots_.empty() ? 16 : slots_.size()*2, -1);
+
+    std::size_t mask = slots_.size()-1;
+    for( std::size_t i=0; i<entries_.size(); ++i ) {
+        std::size_t slot = entries_[i].hash & mask;
+        while( slots_[slot] >= 0 )
+            slot = (slot+1) & mask;
+        slots_[slot] = i;
+    }
+}
+
+
+// Add a null terminated string to the buffer and return its offset
+//
+uint32_t CmdLineArgs::Map::store(const std::string &str)
+{
+    uint32_t offset = buffer_.size();
+    buffer_.append(str.c_str(), str.size()+1);
+    return offset;
+}
+
+
+
+/**
+   @brief To parse in parallel a stream of command lines, one per line, all having the same options.
+   The lines are read by chunks, each chunk being parsed by a pool of threads taking the lines by blocks, so the memory
+   stays bounded whatever the size of the input. The threads are started once, and wait for each chunk. Each thread
+   has its own CmdLineArgs, reset for each line, which collects the errors.
+   @param in the stream of command lines, quoted as in a POSIX shell.
+   @param columns an object holding the results by columns, typically one vector per option, with:
+   - void resize(std::size_t nb_lines): called before parsing a chunk, to size the columns.
+   - void parse(CmdLineArgs &cl, std::size_t row): to get the options of one line (with getParam...) and store them
+     in the row of the columns. It is called concurrently for different rows, so it should only write to that row.
+     (Beware of std::vector<bool>)
+   - void flush(std::size_t first_line, std::size_t nb_lines, const std::vector<BatchErrors> &errors): called once
+     a chunk is parsed, with the errors of its faulty lines sorted by line.
+   @param nb_threads the number of threads, or 0 for the number of cores.
+   @param chunk_size the number of lines in a chunk.
+   @return the number of lines parsed.
+   @note An exception thrown by columns.parse is thrown back once the chunk is parsed.
+ */
+template <class Columns>
+std::size_t CmdLineArgs::parseBatch(std::istream &in, Columns &columns, unsigned nb_threads, std::size_t chunk_size)
+{
+    const std::size_t block_size = 64;
+
+    if( nb_threads == 0 )
+        nb_threads = std::max(1u, std::thread::hardware_concurrency());
+    if( chunk_size == 0 )
+        chunk_size = 1;
+    nb_threads = std::min<std::size_t>(nb_threads, (chunk_size + block_size - 1) / block_size);
+
+    std::vector<std::unique_ptr<CmdLineArgs> > parsers(nb_threads);
+    std::vector<std::vector<BatchErrors> > thread_errors(nb_threads);
+    std::vector<BatchErrors> errors;
+    std::vector<std::string> lines(chunk_size);
+    std::size_t first_line = 0;
+    std::size_t nb_lines = 0;
+
+    std::atomic<std::size_t> next_row(0);
+    std::exception_ptr exception;
+    std::atomic_flag exception_lock = ATOMIC_FLAG_INIT;
+
+    // To parse the rows of the chunk by blocks, in the thread t:
+    auto work = [&](unsigned t) {
+        try {
+            std::unique_ptr<CmdLineArgs> &cl = parsers[t];
+            std::size_t row;
+            while( (row = next_row.fetch_add(block_size)) < nb_lines ) {
+                std::size_t end = std::min(row + block_size, nb_lines);
+                for( ; row<end; ++row ) {
+                    if( !cl ) {
+                        cl.reset(new CmdLineArgs(std::string(), ""));
+                        cl->collectErrors();
+                        cl->parseCmdLine(lines[row]);
+                    } else
+                        cl->reset(lines[row]);
+
+                    columns.parse(*cl, row);
+
+                    if( !cl->errors_.empty() ) {
+                        BatchErrors line_errors = { first_line + row, cl->errors_, std::string() };
+                        for( auto &error: cl->errors_ )
+                            line_errors.message += cl->errorMessage(error);
+                        thread_errors[t].push_back(std::move(line_errors));
+                    }
+                }
+            }
+        } catch (...) {
+            while( exception_lock.test_and_set() );
+            if( !exception )
+                exception = std::current_exception();
+            exception_lock.clear();
+            next_row = nb_lines;
+        }
+    };
+
+    // The other threads, waiting for each chunk. They are stopped when leaving, even by an exception.
+    struct Pool {
+        std::mutex mutex;
+        std::condition_variable start, done;
+        std::size_t chunk = 0;              // The number of chunks given to the threads
+        std::size_t nb_busy = 0;            // The threads parsing the current chunk
+        bool stop = false;
+        std::vector<std::thread> threads;
+
+        ~Pool() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stop = true;
+            }
+            start.notify_all();
+            for( auto &thread: threads )
+                thread.join();
+        }
+    } pool;
+
+    for( unsigned t=1; t<nb_threads; ++t )
+        pool.threads.emplace_back([&pool, &work, t]{
+            for( std::size_t chunk = 0;; ) {
+                {
+                    std::unique_lock<std::mutex> lock(pool.mutex);
+                    pool.start.wait(lock, [&]{ return pool.stop || pool.chunk != chunk; });
+                    if( pool.stop )
+                        return;
+                    chunk = pool.chunk;
+                }
+                work(t);
+                {
+                    std::lock_guard<std::mutex> lock(pool.mutex);
+                    --pool.nb_busy;
+                }
+                pool.done.notify_one();
+            }
+        });
+
+    while( in ) {
+
+        // Read a chunk, reusing the strings of the previous one:
+        nb_lines = 0;
+        while( nb_lines < chunk_size && std::getline(in, lines[nb_lines]) )
+            ++nb_lines;
+        if( nb_lines == 0 )
+            break;
+
+        columns.resize(nb_lines);
+
+        // The other threads are woken up, and this one parses with them:
+        next_row = 0;
+        {
+            std::lock_guard<std::mutex> lock(pool.mutex);
+            pool.nb_busy = pool.threads.size();
+            ++pool.chunk;
+        }
+        pool.start.notify_all();
+        work(0);
+        {
+            std::unique_lock<std::mutex> lock(pool.mutex);
+            pool.done.wait(lock, [&pool]{ return pool.nb_busy == 0; });
+        }
+
+        if( exception )
+            std::rethrow_exception(exception);
+
+        // Gather the errors in the order of the lines:
+        errors.clear();
+        for( auto &errs: thread_errors ) {
+            std::move(errs.begin(), errs.end(), std::back_inserter(errors));
+            errs.clear();
+        }
+        std::sort(errors.begin(), errors.end(), [](const BatchErrors &a, const BatchErrors &b){ return a.line < b.line; });
+
+        columns.flush(first_line, nb_lines, errors);
+        first_line += nb_lines;
+    }
+
+    return first_line;
+}
+
+
+
+/**
+   @brief To get a path, which is probed by a background thread while the parsing goes on.
+   Probing the paths concurrently hides the latency of the file system.
+   @param long_name long name of the parameter (so starting with "--").
+   @param short_name short name of the parameter (so a single letter starting with "-").
+   @param default_value default path, if the parameter is not present. It is probed too, unless empty.
+   @param desc A description of the parameter. (will go into the usage)
+   @param probes the probes to do, combining: ProbeStat for the existence, type, size and permissions,
+   ProbeOpen to also open a file, and ProbeReadahead to also hint the system that the file will be read.
+   @return the future result of the probes.
+ */
+std::shared_future<CmdLineArgs::PathInfo> CmdLineArgs::getPath(const std::string &long_name, char short_name,
+                                                               const std::string &default_value,
+                                                               const std::string &desc, unsigned probes)
+{
+    return probe(getParam(long_name, short_name, default_value, desc), probes);
+}
+
+
+/**
+   @brief To get a path, no short name allowed.
+   @see getPath(const std::string&, char, const std::string&, const std::string&, unsigned)
+ */
+std::shared_future<CmdLineArgs::PathInfo> CmdLineArgs::getPath(const std::string &long_name, const std::string &default_value,
+                                                               const std::string &desc, unsigned probes)
+{
+    return getPath(long_name, ' ', default_value, desc, probes);
+}
+
+
+/**
+   @brief To probe the remaining arguments as paths, once the options are retrieved.
+   @param probes the probes to do, as for getPath.
+   @return the future results of the probes, in the order of the arguments. Options are skipped.
+ */
+std::vector<std::shared_future<CmdLineArgs::PathInfo> > CmdLineArgs::probeRemaining(unsigned probes)
+{
+    std::vector<std::shared_future<PathInfo> > infos;
+    for( auto &arg: args_ )
+        if( arg[0] != '-' )
+            infos.push_back(probe(arg, probes));
+    return infos;
+}
+
+
+/**
+   @brief To probe a path at once, in the calling thread.
+   @param path the path.
+   @param probes the probes to do, as for getPath.
+   @return what is known about the path.
+ */
+CmdLineArgs::PathInfo CmdLineArgs::probePath(const std::string &path, unsigned probes)
+{
+    PathInfo info = { path, 0, false, false, false, false, false, 0, -1 };
+
+#if defined(__unix__) || defined(__APPLE__)
+    struct stat st;
+    if( stat(path.c_str(), &st) != 0 ) {
+        info.error = errno;
+        return info;
+    }
+
+    info.exists = true;
+    info.is_file = S_ISREG(st.st_mode);
+    info.is_dir = S_ISDIR(st.st_mode);
+    info.size = st.st_size;
+    info.readable = access(path.c_str(), R_OK) == 0;
+    info.writable = access(path.c_str(), W_OK) == 0;
+
+    if( (probes & (ProbeOpen | ProbeReadahead)) && info.is_file ) {
+        info.fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if( info.fd < 0 ) {
+            info.error = errno;
+            return info;
+        }
+
+#if defined(POSIX_FADV_WILLNEED)
+        if( probes & ProbeReadahead )
+            posix_fadvise(info.fd, 0, 0, POSIX_FADV_WILLNEED);
+#endif
+        if( !(probes & ProbeOpen) ) {
+            close(info.fd);
+            info.fd = -1;
+        }
+    }
+#else
+    (void)probes;
+    info.error = ENOSYS;
+#endif
+
+    return info;
+}
+
+
+// To start probing a path in the background
+//
+std::shared_future<CmdLineArgs::PathInfo> CmdLineArgs::probe(const std::string &path, unsigned probes)
+{
+    if( path.empty() ) {
+        std::promise<PathInfo> none;
+        none.set_value(PathInfo{ path, ENOENT, false, false, false, false, false, 0, -1 });
+        return none.get_future().share();
+    }
+
+    if( !probe_pool_ )
+        probe_pool_ = std::make_shared<ProbePool>(std::max(1u, std::min(4u, std::thread::hardware_concurrency())));
+
+    return probe_pool_->submit(path, probes);
+}
+
+
+CmdLineArgs::ProbePool::ProbePool(unsigned nb_threads)
+    :stop_(false)
+{
+    for( unsigned i=0; i<nb_threads; ++i )
+        threads_.emplace_back(&ProbePool::run, this);
+}
+
+
+// The probes not done yet are done before stopping
+//
+CmdLineArgs::ProbePool::~ProbePool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cond_.notify_all();
+
+    for( auto &thread: threads_ )
+        thread.join();
+}
+
+
+std::shared_future<CmdLineArgs::PathInfo> CmdLineArgs::ProbePool::submit(const std::string &path, unsigned probes)
+{
+    std::packaged_task<PathInfo()> task(std::bind(&CmdLineArgs::probePath, path, probes));
+    std::shared_future<PathInfo> info = task.get_future().share();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push_back(std::move(task));
+    }
+    cond_.notify_one();
+
+    return info;
+}
+
+
+void CmdLineArgs::ProbePool::run()
+{
+    for(;;) {
+        std::packaged_task<PathInfo()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cond_.wait(lock, [this]{ return stop_ || !tasks_.empty(); });
+            if( tasks_.empty() )
+                return;
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+        task();
+    }
+}
+
+
+
+/**
+   @brief To get the index of an option, to look its value up quickly.
+   @param long_name the long name of the option.
+   @return the index of the option, or -1 if no option has this name.
+ */
+int CmdLineArgs::optionId(const std::string &long_name) const
+{
+    return findId(long_name);
+}
+
+
+/**
+   @brief Tells if an option was present, or is overridden in the current thread.
+   @param id the index of the option, given by optionId(). False for an unknown option.
+ */
+bool CmdLineArgs::wasPresent(int id) const
+{
+    if( id < 0 || unsigned(id) >= options_.size() )
+        return false;
+
+    return isSet(id) || (ScopedOverride::current() && findOverride(id));
+}
+
+
+/**
+   @brief To get the value of a parameter as given on the command line, or as overridden in the current thread.
+   @param id the index of the option, given by optionId().
+   @return the value, empty if the parameter was not present or is unknown.
+   @note Without any override in the current thread, this is a bounds check, a test and an indexed load.
+ */
+const std::string& CmdLineArgs::rawValue(int id) const
+{
+    static const std::string none;
+    if( id < 0 || unsigned(id) >= options_.size() )
+        return none;
+
+    if( ScopedOverride::current() ) {
+        const std::string *value = findOverride(id);
+        if( value )
+            return *value;
+    }
+
+    return options_[id].value;
+}
+
+
+/**
+   @brief To get the value of a parameter, or as overridden in the current thread, converted to a type.
+   @param id the index of the option, given by optionId().
+   @param default_value the value to give if the parameter is unknown, not present or not correct.
+   @return the value.
+ */
+template <class T>
+T CmdLineArgs::value(int id, T default_value) const
+{
+    if( !wasPresent(id) )
+        return default_value;
+
+    T val;
+    if( convert(rawValue(id), val) )
+        return val;
+
+    return default_value;
+}
+
+
+/// @cond SPECIALISATIONS
+std::string CmdLineArgs::value(int id, const char *default_value) const
+{
+    return wasPresent(id) ? rawValue(id) : default_value;
+}
+/// @endcond
+
+
+// The innermost override of an option in the current thread, or nullptr
+//
+const std::string* CmdLineArgs::findOverride(int id) const
+{
+    for( ScopedOverride *scope = ScopedOverride::current(); scope; scope = scope->prev_ ) {
+        if( scope->cl_ != this )
+            continue;
+        for( auto pos = scope->values_.rbegin(); pos != scope->values_.rend(); ++pos )
+            if( pos->first == id )
+                return &pos->second;
+    }
+
+    return nullptr;
+}
+
+
+/**
+   @brief Constructor, starting a scope of overrides in the current thread.
+   @param cl the parsing whose values are overridden.
+ */
+CmdLineArgs::ScopedOverride::ScopedOverride(const CmdLineArgs &cl)
+    :cl_(&cl), prev_(current())
+{
+    current() = this;
+}
+
+
+CmdLineArgs::ScopedOverride::~ScopedOverride()
+{
+    current() = prev_;
+}
+
+
+/**
+   @brief To override the value of a parameter.
+   @param id the index of the option, given by CmdLineArgs::optionId().
+   @param value the value, as it would be given on the command line.
+   @return the object, to chain the calls.
+ */
+CmdLineArgs::ScopedOverride& CmdLineArgs::ScopedOverride::set(int id, const std::string &value)
+{
+    values_.push_back(std::make_pair(id, value));
+    return *this;
+}
+
+
+/**
+   @brief To override the value of a parameter.
+   @param id the index of the option, given by CmdLineArgs::optionId().
+   @param value the value.
+   @return the object, to chain the calls.
+ */
+template <class T>
+CmdLineArgs::ScopedOverride& CmdLineArgs::ScopedOverride::set(int id, const T &value)
+{
+    std::ostringstream oss;
+    oss << value;
+    return set(id, oss.str());
+}
+
+
+// The innermost scope of the current thread
+//
+CmdLineArgs::ScopedOverride*& CmdLineArgs::ScopedOverride::current()
+{
+    static thread_local ScopedOverride *scope = nullptr;
+    return scope;
+}
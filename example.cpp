@@ -23,6 +23,7 @@ int main(int argc, char **argv){
 	
 	try{
         CmdLineArgs cl(argc, argv, "Example of command line arguments");
+        cl.setUsageWidth(CmdLineArgs::terminalWidth());
 
         help            = cl.getFlag("help", "Getting usage");
         name            = cl.getParam("name", "stone", "The name of something");
@@ -3,6 +3,8 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <sstream>
+#include <thread>
 
 #include "CmdLineArgs.h"
 
@@ -12,6 +14,18 @@ using namespace std;
 
 void fixTest(int test_no, int argc, const char **argv, int& failures);
 void getParamsTest(int test_no, int& failures);
+void usageTest(int test_no, int& failures);
+void errorsTest(int test_no, int& failures);
+void cmdLineTest(int test_no, int& failures);
+void snapshotTest(int test_no, int& failures);
+void accumulateTest(int test_no, int& failures);
+void rangesTest(int test_no, int& failures);
+void constraintsTest(int test_no, int& failures);
+void mapTest(int test_no, int& failures);
+void batchTest(int test_no, int& failures);
+void lazyTest(int test_no, int& failures);
+void pathsTest(int test_no, int& failures);
+void overrideTest(int test_no, int& failures);
 
 int main(int argc, char**argv) {
 
@@ -29,6 +43,42 @@ int main(int argc, char**argv) {
     
     // Test getParams in more depth
     getParamsTest(3, nbFails);
+
+    // Test the usage formatting and wrapping
+    usageTest(4, nbFails);
+
+    // Test the collection of errors
+    errorsTest(5, nbFails);
+
+    // Test the parsing of command lines, reusing the options
+    cmdLineTest(6, nbFails);
+
+    // Test the snapshots of a parsing
+    snapshotTest(7, nbFails);
+
+    // Test the accumulation of repeated parameters
+    accumulateTest(8, nbFails);
+
+    // Test the parameters given as ranges
+    rangesTest(9, nbFails);
+
+    // Test the constraints on the options
+    constraintsTest(10, nbFails);
+
+    // Test the key=value map parameters
+    mapTest(11, nbFails);
+
+    // Test the parallel parsing of many command lines
+    batchTest(12, nbFails);
+
+    // Test the parameters converted when used
+    lazyTest(13, nbFails);
+
+    // Test the paths probed while parsing
+    pathsTest(14, nbFails);
+
+    // Test the overrides of the parsed values
+    overrideTest(15, nbFails);
         
     if( nbFails ) {
         cout << nbFails << " test failed!\n";
@@ -153,3 +203,584 @@ void getParamsTest(int test_no, int& failures) {
     }
 }
 
+
+void usageTest(int test_no, int& failures) {
+
+    const char* argv[] = {"test"};
+    int argc = nelem(argv);
+
+    CmdLineArgs cl(argc, const_cast<char**>(argv), "Intro");
+    cl.getFlag("help", 'h', "Getting usage");
+    cl.getParam("nb", 3, "The number of frames\nanother line");
+
+    string expected = "Intro\nOptions are:\n"
+                      "    --help (-h) " + string(10, ' ') + "Getting usage\n"
+                      "    --nb (default: 3)     The number of frames\n" +
+                      string(26, ' ') + "another line\n";
+    if( cl.usage() != expected ) {
+        cout << "Test " << test_no << ": Usage failure. Got:\n" << cl.usage() << "instead of:\n" << expected;
+        ++failures;
+        return;
+    }
+
+    // The cached usage must follow the changes:
+    cl.addUsageOutro("Outro\n");
+    ostringstream oss;
+    cl.usage(oss);
+    if( oss.str() != expected + "Outro\n" ) {
+        cout << "Test " << test_no << ": Usage cache failure. Got:\n" << oss.str();
+        ++failures;
+        return;
+    }
+
+    // Wrapping:
+    cl.getParam("long", 0, "one two three four five six seven eight nine ten eleven twelve thirteen fourteen");
+    cl.setUsageWidth(50);
+    istringstream lines(cl.usage());
+    string line;
+    int nb_lines = 0;
+    while( getline(lines, line) ) {
+        ++nb_lines;
+        if( line.size() > 50 ) {
+            cout << "Test " << test_no << ": Usage wrapping failure. Line too long: " << line << "\n";
+            ++failures;
+            return;
+        }
+    }
+    if( nb_lines < 8 ) {
+        cout << "Test " << test_no << ": Usage wrapping failure. Got:\n" << cl.usage();
+        ++failures;
+    }
+}
+
+void errorsTest(int test_no, int& failures) {
+
+    const char* argv[] = {"test", "--nb", "abc", "--values", "1,2", "--ratio", "0.5", "-x", "--name"};
+    int argc = nelem(argv);
+
+    CmdLineArgs cl(argc, const_cast<char**>(argv), "Test of command line arguments");
+    cl.collectErrors();
+
+    int n = 0;
+    float f = 0;
+    string s;
+    try{
+        n = cl.getParam("nb", 7, "An int");
+        cl.getParams("values", vector<int>{1, 2, 3}, true, "3 ints");
+        f = cl.getParam("ratio", 0.2f, "A float");
+        s = cl.getParam("name", "none", "A name");
+        cl.throwIfUnparsed();
+    } catch (const exception& error) {
+        cout << "Test " << test_no << ": Collecting errors failure, got an exception: " << error.what() << endl;
+        ++failures;
+        return;
+    }
+
+    const vector<CmdLineArgs::Error> &errors = cl.errors();
+    if( errors.size() != 4 || n != 7 || f != 0.5f || s != "none"
+        || errors[0].code != CmdLineArgs::ErrorCode::IncorrectValue || errors[0].option != 0
+        || errors[1].code != CmdLineArgs::ErrorCode::WrongNbValues  || errors[1].option != 1
+        || errors[2].code != CmdLineArgs::ErrorCode::MissingValue   || errors[2].option != 3
+        || errors[3].code != CmdLineArgs::ErrorCode::Unparsed ) {
+        cout << "Test " << test_no << ": Collecting errors failure. Got " << errors.size() << " errors:";
+        for( auto &error: errors )
+            cout << cl.errorMessage(error);
+        cout << "\n";
+        ++failures;
+        return;
+    }
+
+    if( cl.errorMessage(errors[1]) != "\nError: parameter --values is not followed by 3 values as expected." ) {
+        cout << "Test " << test_no << ": Error message failure. Got: " << cl.errorMessage(errors[1]) << "\n";
+        ++failures;
+        return;
+    }
+
+    try{
+        cl.throwIfErrors();
+        cout << "Test " << test_no << ": throwIfErrors failure.\n";
+        ++failures;
+    } catch (const runtime_error&) {
+    }
+}
+
+void cmdLineTest(int test_no, int& failures) {
+
+    vector<string> tokens = CmdLineArgs::tokenize(" --nb 12\t--name 'hello me' a\\ b \"x\\\"y\" '' z\"w\"");
+    vector<string> zeTokens = {"--nb", "12", "--name", "hello me", "a b", "x\"y", "", "zw"};
+    if( tokens != zeTokens ) {
+        cout << "Test " << test_no << ": Tokenizer failure. Got:";
+        for( auto &tok: tokens )
+            cout << " [" << tok << "]";
+        cout << "\n";
+        ++failures;
+        return;
+    }
+
+    tokens = CmdLineArgs::tokenize("a \\\n b\\\nc");
+    if( tokens != vector<string>({"a", "bc"}) ) {
+        cout << "Test " << test_no << ": Tokenizer of joined lines failure. Got:";
+        for( auto &tok: tokens )
+            cout << " [" << tok << "]";
+        cout << "\n";
+        ++failures;
+        return;
+    }
+
+    const char* lines[] = { "--nb 12 --name 'hello me' -v", "--name=other -vv", "--nb 3 remain" };
+    int zeNb[] = { 12, 0, 3 };
+    const char* zeName[] = { "hello me", "other", "" };
+    int zeV[] = { 1, 2, 0 };
+
+    try{
+        CmdLineArgs cl(lines[0], "Test of command line arguments");
+        for( unsigned i=0; i<nelem(lines); ++i ) {
+            if( i > 0 )
+                cl.reset(lines[i]);
+
+            int v = cl.getFlag("verbose", 'v', "To increase the verbosity");
+            int n = cl.getParam("nb", 0, "The number of frames");
+            string s = cl.getParam("name", "", "The name of frame");
+
+            if( n != zeNb[i] || s != zeName[i] || v != zeV[i] || cl.getRemaining().size() != (i==2 ? 1u : 0u) ) {
+                cout << "Test " << test_no << ": Command line " << i << " failure. Got " << n << ", " << s << ", " << v << "\n";
+                ++failures;
+                return;
+            }
+        }
+
+        if( count(cl.usage().begin(), cl.usage().end(), '\n') != 5 ) {
+            cout << "Test " << test_no << ": Usage of reset failure. Got:\n" << cl.usage();
+            ++failures;
+            return;
+        }
+
+        // The options skipped or in another order after a reset:
+        cl.reset("--name again -v");
+        string s = cl.getParam("name", "", "The name of frame");
+        int v = cl.getFlag("verbose", 'v', "To increase the verbosity");
+        cl.reset("--nb 7");
+        int n = cl.getParam("nb", 0, "The number of frames");
+        if( s != "again" || v != 1 || n != 7 || cl.optionId("nb") != 1 || cl.wasPresent("name")
+            || count(cl.usage().begin(), cl.usage().end(), '\n') != 5 ) {
+            cout << "Test " << test_no << ": Reordered options failure. Got " << s << ", " << v << ", " << n << " and:\n" << cl.usage();
+            ++failures;
+        }
+    } catch (const exception& error) {
+        cout << "Test " << test_no << ": Unparsed failure: " << error.what() << endl;
+        ++failures;
+    }
+}
+
+void snapshotTest(int test_no, int& failures) {
+
+    try{
+        CmdLineArgs cl("-vv --nb 12 --name 'hello me' remain", "Test of command line arguments");
+        cl.getFlag("verbose", 'v', "To increase the verbosity");
+        cl.getParam("nb", 0, "The number of frames");
+        cl.getParam("name", "", "The name of frame");
+        cl.getParam("ratio", 0.2f, "The frame ratio");
+
+        string image = cl.snapshot();
+        CmdLineArgs::Snapshot snap(image.data(), image.size());
+
+        int fd = cl.snapshotFd();
+        CmdLineArgs::Snapshot mapped = CmdLineArgs::Snapshot::map(fd);
+        close(fd);
+
+        for( const CmdLineArgs::Snapshot *s: {&snap, &mapped} ) {
+            if( s->getFlag("verbose") != 2 || s->getParam("nb", 0) != 12 || s->getParam("name", "") != "hello me"
+                || s->isPresent("ratio") || s->getParam("ratio", 0.2f) != 0.2f
+                || s->nbRemaining() != 1 || string(s->getRemaining(0)) != "remain" ) {
+                cout << "Test " << test_no << ": Snapshot failure.\n";
+                ++failures;
+                return;
+            }
+        }
+
+        image[image.size()-1] ^= 1;
+        try{
+            CmdLineArgs::Snapshot corrupted(image.data(), image.size());
+            cout << "Test " << test_no << ": Corrupted snapshot not detected.\n";
+            ++failures;
+        } catch (const runtime_error&) {
+        }
+    } catch (const exception& error) {
+        cout << "Test " << test_no << ": Unparsed failure: " << error.what() << endl;
+        ++failures;
+    }
+}
+
+void accumulateTest(int test_no, int& failures) {
+
+    try{
+        CmdLineArgs cl("--input a -vi b remain --input c,d --num 1,2 -n 3 --num 4", "Test of command line arguments");
+        vector<string> inputs = cl.getAllParams<string>("input", 'i', "Input files", ',');
+        vector<int> numbers = cl.getParams("num", 'n', vector<int>{0}, false, "Numbers", ',', true);
+        int v = cl.getFlag("verbose", 'v', "To increase the verbosity");
+
+        vector<string> zeInputs = {"a", "b", "c", "d"};
+        vector<int> zeNumbers = {1, 2, 3, 4};
+        vector<string> zeRemaining = {"remain"};
+        if( inputs != zeInputs || numbers != zeNumbers || v != 1 || cl.getRemaining() != zeRemaining ) {
+            cout << "Test " << test_no << ": Accumulation failure. Got";
+            for( auto &in: inputs )
+                cout << " " << in;
+            for( auto n: numbers )
+                cout << " " << n;
+            cout << "\n";
+            ++failures;
+        }
+    } catch (const exception& error) {
+        cout << "Test " << test_no << ": Unparsed failure: " << error.what() << endl;
+        ++failures;
+    }
+}
+
+void rangesTest(int test_no, int& failures) {
+
+    try{
+        CmdLineArgs cl("--cpus 32-47,0-15,8,16 --shards 0-65535:4", "Test of command line arguments");
+        CmdLineArgs::RangeSet cpus = cl.getParam("cpus", 'c', CmdLineArgs::RangeSet("0-3"), "CPUs to use");
+        CmdLineArgs::RangeSet shards = cl.getParam("shards", CmdLineArgs::RangeSet(), "Shards");
+        CmdLineArgs::RangeSet other = cl.getParam("other", CmdLineArgs::RangeSet("1,0x10-0x11"), "Other");
+
+        vector<long long> values(cpus.begin(), cpus.end());
+        bitset<64> bits = cpus.toBitset<64>();
+        if( cpus.str() != "0-16,32-47" || cpus.size() != 33 || values.size() != 33 || values[16] != 16 || values[17] != 32
+            || !cpus.contains(40) || cpus.contains(20) || bits.count() != 33 || !bits.test(47)
+            || shards.size() != 16384 || !shards.contains(65532) || shards.contains(65533)
+            || other.str() != "1,16-17" ) {
+            cout << "Test " << test_no << ": Ranges failure. Got " << cpus << " and " << shards << " and " << other << "\n";
+            ++failures;
+            return;
+        }
+
+        CmdLineArgs::RangeSet set;
+        if( CmdLineArgs::RangeSet::parse("3-1", set) || CmdLineArgs::RangeSet::parse("1-4:0", set)
+            || CmdLineArgs::RangeSet::parse("1,", set) || CmdLineArgs::RangeSet::parse("1-", set) ) {
+            cout << "Test " << test_no << ": Incorrect ranges not detected.\n";
+            ++failures;
+        }
+
+        // Overlapping ranges, with strides:
+        CmdLineArgs::RangeSet all("0-10,0-10:2"), mixed("0-10:5,3"), strides("0-30:4,0-30:6,20-25:3");
+        vector<long long> mixed_values(mixed.begin(), mixed.end()), strides_values(strides.begin(), strides.end());
+        vector<long long> expected = { 0, 4, 6, 8, 12, 16, 18, 20, 23, 24, 28, 30 };
+        if( all.size() != 11 || vector<long long>(all.begin(), all.end()).size() != 11
+            || mixed_values != vector<long long>({ 0, 3, 5, 10 }) || mixed.size() != 4
+            || strides_values != expected || strides.size() != expected.size()
+            || !strides.contains(23) || strides.contains(22) || strides.toBitset<32>().count() != expected.size() ) {
+            cout << "Test " << test_no << ": Overlapping ranges failure. Got " << all.size() << " and " << mixed.size()
+                 << " and " << strides.size() << " values\n";
+            ++failures;
+            return;
+        }
+
+        // Large coprime strides, whose common period is too long to be expanded:
+        CmdLineArgs::RangeSet coprimes("0-1000000000000000:99999989,0-1000000000000000:99999971");
+        CmdLineArgs::RangeSet primes("0-1000000000000:2,0-1000000000000:3,0-1000000000000:5,0-1000000000000:7,"
+                                     "0-1000000000000:11,0-1000000000000:13,0-1000000000000:17,0-1000000000000:19,"
+                                     "0-1000000000000:23,0-1000000000000:29");
+        vector<long long> firsts;
+        for( auto v: coprimes ) {
+            if( firsts.size() == 5 )
+                break;
+            firsts.push_back(v);
+        }
+        if( coprimes.size() != 20000004 || firsts != vector<long long>({ 0, 99999971, 99999989, 199999942, 199999978 })
+            || !coprimes.contains(99999989LL * 7) || coprimes.contains(99999989LL * 7 + 1)
+            || primes.size() != 842052776900ULL || primes.contains(31 * 37) || !primes.contains(29 * 31) ) {
+            cout << "Test " << test_no << ": Large strides failure. Got " << coprimes.size() << " and " << primes.size() << " values\n";
+            ++failures;
+            return;
+        }
+
+        // The whole range of values:
+        CmdLineArgs::RangeSet whole("-9223372036854775808-9223372036854775807:3");
+        if( whole.size() != 6148914691236517206ULL || whole.ranges()[0].last != 9223372036854775807LL
+            || !whole.contains(-9223372036854775807LL - 1) || whole.contains(0) || !whole.contains(1) ) {
+            cout << "Test " << test_no << ": Whole range failure. Got " << whole << " with " << whole.size() << " values\n";
+            ++failures;
+        }
+    } catch (const exception& error) {
+        cout << "Test " << test_no << ": Unparsed failure: " << error.what() << endl;
+        ++failures;
+    }
+}
+
+void constraintsTest(int test_no, int& failures) {
+
+    CmdLineArgs cl("--nb 12 --mode slow --quiet --verbose --out x", "Test of command line arguments");
+    cl.collectErrors();
+    cl.addRange("nb", 0, 10);
+    cl.addChoices("mode", {"fast", "exact"});
+    cl.addExclusive({"quiet", "verbose"});
+    cl.addRequires("out", "format");
+    cl.addRange("ratio", 0, 1);
+
+    cl.getParam("nb", 0, "The number of frames");
+    cl.getParam("mode", "fast", "The mode");
+    cl.getFlag("quiet", "No output");
+    cl.getFlag("verbose", "More output");
+    cl.getParam("out", "", "Output file");
+    cl.getParam("format", "", "Output format");
+    cl.getParam("ratio", 0.5, "The ratio");
+    cl.checkConstraints();
+
+    const vector<CmdLineArgs::Error> &errors = cl.errors();
+    if( errors.size() != 4 || !cl.wasPresent("quiet") || cl.wasPresent("format")
+        || errors[0].code != CmdLineArgs::ErrorCode::OutOfRange
+        || errors[1].code != CmdLineArgs::ErrorCode::InvalidChoice
+        || errors[2].code != CmdLineArgs::ErrorCode::Exclusive || errors[2].option != 3 || errors[2].other != 2
+        || errors[3].code != CmdLineArgs::ErrorCode::MissingRequired ) {
+        cout << "Test " << test_no << ": Constraints failure. Got " << errors.size() << " errors:";
+        for( auto &error: errors )
+            cout << cl.errorMessage(error);
+        cout << "\n";
+        ++failures;
+        return;
+    }
+
+    const string &usage = cl.usage();
+    if( usage.find("The mode [one of: fast exact]") == string::npos || usage.find("[0 to 10]") == string::npos
+        || usage.find("No output [excludes --verbose]") == string::npos || usage.find("[requires --format]") == string::npos ) {
+        cout << "Test " << test_no << ": Constraints usage failure. Got:\n" << usage;
+        ++failures;
+        return;
+    }
+
+    // Only the parameters with several values are split, at their own separator:
+    CmdLineArgs multi("--pair a,b --sizes 4;20 --tag a,b --tag c --cpus 0-15,32-47", "Test of command line arguments");
+    multi.collectErrors();
+    multi.addChoices("pair", {"a,b", "c"});
+    multi.addRange("sizes", 0, 10);
+    multi.addChoices("tag", {"a,b", "c"});
+    multi.addChoices("cpus", {"0-15,32-47"});
+
+    multi.getParam("pair", "c", "A pair");
+    multi.getParams("sizes", vector<int>(), false, "Sizes", ';');
+    multi.getAllParams<string>("tag", "Tags");
+    multi.getParam("cpus", CmdLineArgs::RangeSet("0"), "CPUs");
+    multi.checkConstraints();
+
+    if( multi.errors().size() != 1 || multi.errors()[0].code != CmdLineArgs::ErrorCode::OutOfRange || multi.errors()[0].option != 1 ) {
+        cout << "Test " << test_no << ": Constraints of multiple values failure. Got " << multi.errors().size() << " errors:";
+        for( auto &error: multi.errors() )
+            cout << multi.errorMessage(error);
+        cout << "\n";
+        ++failures;
+    }
+}
+
+void mapTest(int test_no, int& failures) {
+
+    const char* argv[] = {"test", "--define", "k1=v1", "-D", "k2=a=b", "--define=k3=3,k1=last", "--set", "x=1,y=2,x=3"};
+    int argc = nelem(argv);
+
+    try{
+        CmdLineArgs cl(argc, const_cast<char**>(argv), "Test of command line arguments");
+        cl.collectErrors();
+        CmdLineArgs::Map defines = cl.getMap("define", 'D', "Definitions");
+        CmdLineArgs::Map sets = cl.getMap("set", "Settings", CmdLineArgs::Duplicates::Refuse);
+
+        if( defines.size() != 3 || defines.get("k1", "") != "last" || defines.get("k2", "") != "a=b"
+            || defines.get("k3", 0) != 3 || defines.contains("k4") || string(defines.key(1)) != "k2"
+            || !sets.empty() || cl.errors().size() != 1 || cl.errors()[0].code != CmdLineArgs::ErrorCode::DuplicateKey ) {
+            cout << "Test " << test_no << ": Map failure. Got " << defines.size() << " definitions.\n";
+            ++failures;
+            return;
+        }
+
+        CmdLineArgs::Map big;
+        for( int i=0; i<5000; ++i )
+            big.insert("key" + to_string(i), to_string(i));
+        for( int i=0; i<5000; ++i )
+            if( big.get("key" + to_string(i), -1) != i ) {
+                cout << "Test " << test_no << ": Big map failure at " << i << "\n";
+                ++failures;
+                return;
+            }
+    } catch (const exception& error) {
+        cout << "Test " << test_no << ": Unparsed failure: " << error.what() << endl;
+        ++failures;
+    }
+}
+
+// The columns of the results of the batch test
+struct BatchColumns {
+    vector<int> nb;
+    vector<string> name;
+    vector<size_t> all_nb;
+    vector<size_t> error_lines;
+    size_t nb_lines = 0;
+
+    void resize(size_t nb_lines) {
+        nb.resize(nb_lines);
+        name.resize(nb_lines);
+    }
+
+    void parse(CmdLineArgs &cl, size_t row) {
+        nb[row] = cl.getParam("nb", 'n', -1, "A number");
+        name[row] = cl.getParam("name", "", "A name");
+        cl.throwIfUnparsed();
+    }
+
+    void flush(size_t first_line, size_t nb_lines, const vector<CmdLineArgs::BatchErrors> &errors) {
+        for( size_t i=0; i<nb_lines; ++i )
+            all_nb.push_back(nb[i]);
+        for( auto &err: errors )
+            error_lines.push_back(err.line);
+        this->nb_lines += nb_lines;
+        (void)first_line;
+    }
+};
+
+void batchTest(int test_no, int& failures) {
+
+    stringstream jobs;
+    for( int i=0; i<10000; ++i ) {
+        if( i % 1000 == 999 )
+            jobs << "--nb " << i << " --bad\n";
+        else
+            jobs << "-n " << i << " --name 'job " << i << "'\n";
+    }
+
+    BatchColumns columns;
+    size_t nb_lines;
+    try{
+        nb_lines = CmdLineArgs::parseBatch(jobs, columns, 4, 1500);
+    } catch (const exception& error) {
+        cout << "Test " << test_no << ": Unparsed failure: " << error.what() << endl;
+        ++failures;
+        return;
+    }
+
+    bool ok = nb_lines == 10000 && columns.nb_lines == 10000 && columns.all_nb.size() == 10000 && columns.error_lines.size() == 10;
+    for( size_t i=0; ok && i<columns.all_nb.size(); ++i )
+        ok = columns.all_nb[i] == i;
+    for( size_t i=0; ok && i<columns.error_lines.size(); ++i )
+        ok = columns.error_lines[i] == i*1000 + 999;
+
+    if( !ok ) {
+        cout << "Test " << test_no << ": Batch failure. Got " << nb_lines << " lines and " << columns.error_lines.size() << " errors.\n";
+        ++failures;
+    }
+}
+
+void lazyTest(int test_no, int& failures) {
+
+    const char* line = "--nb 0x10 --ratio abc --name 'hello me'";
+
+    try{
+        CmdLineArgs cl(line, "Test of command line arguments");
+        CmdLineArgs::Lazy<int> nb = cl.getLazyParam("nb", 'n', 0, "The number of frames");
+        CmdLineArgs::Lazy<float> ratio = cl.getLazyParam("ratio", 0.2f, "The frame ratio");
+        CmdLineArgs::Lazy<string> name = cl.getLazyParam("name", "", "The name of frame");
+        CmdLineArgs::Lazy<int> other = cl.getLazyParam("other", 5, "Other");
+
+        float f = 0;
+        if( nb.get() != 16 || name.get() != "hello me" || !nb.isPresent() || other != 5 || other.isPresent()
+            || ratio.tryGet(f) ) {
+            cout << "Test " << test_no << ": Lazy parameters failure.\n";
+            ++failures;
+            return;
+        }
+
+        try{
+            ratio.get();
+            cout << "Test " << test_no << ": Lazy parameter incorrect value not detected.\n";
+            ++failures;
+            return;
+        } catch (const runtime_error&) {
+        }
+
+        // Eager validation:
+        CmdLineArgs eager(line, "Test of command line arguments");
+        eager.collectErrors();
+        eager.convertEagerly();
+        eager.getLazyParam("nb", 'n', 0, "The number of frames");
+        ratio = eager.getLazyParam("ratio", 0.2f, "The frame ratio");
+        if( eager.errors().size() != 1 || eager.errors()[0].option != 1 || ratio.get() != 0.2f ) {
+            cout << "Test " << test_no << ": Eager lazy parameters failure.\n";
+            ++failures;
+        }
+    } catch (const exception& error) {
+        cout << "Test " << test_no << ": Unparsed failure: " << error.what() << endl;
+        ++failures;
+    }
+}
+
+void pathsTest(int test_no, int& failures) {
+
+    const char* argv[] = {"test", "--model", "test.cpp", "--out", "/nonexistent/dir/file", ".", "-v", "test.cpp"};
+    int argc = nelem(argv);
+
+    try{
+        CmdLineArgs cl(argc, const_cast<char**>(argv), "Test of command line arguments");
+        auto model = cl.getPath("model", 'm', "", "The model", CmdLineArgs::ProbeOpen | CmdLineArgs::ProbeReadahead);
+        auto out = cl.getPath("out", "", "The output");
+        auto config = cl.getPath("config", "", "The config");
+        cl.getFlag("verbose", 'v', "To increase the verbosity");
+        auto inputs = cl.probeRemaining();
+
+        const CmdLineArgs::PathInfo &info = model.get();
+        bool ok = info.exists && info.is_file && info.readable && info.size > 0 && info.fd >= 0
+                  && !out.get().exists && out.get().error == ENOENT
+                  && !config.get().exists
+                  && inputs.size() == 2 && inputs[0].get().is_dir && inputs[1].get().is_file && inputs[1].get().fd < 0;
+        if( info.fd >= 0 )
+            close(info.fd);
+
+        if( !ok ) {
+            cout << "Test " << test_no << ": Paths failure.\n";
+            ++failures;
+        }
+    } catch (const exception& error) {
+        cout << "Test " << test_no << ": Unparsed failure: " << error.what() << endl;
+        ++failures;
+    }
+}
+
+void overrideTest(int test_no, int& failures) {
+
+    CmdLineArgs cl("--batch 32 --threshold 0.5", "Test of command line arguments");
+    cl.getParam("batch", 16, "The batch size");
+    cl.getParam("threshold", 0.1, "The threshold");
+    cl.getParam("mode", "fast", "The mode");
+
+    int batch = cl.optionId("batch");
+    int threshold = cl.optionId("threshold");
+    int mode = cl.optionId("mode");
+
+    bool ok = cl.optionId("none") == -1 && cl.value(batch, 0) == 32 && cl.rawValue(threshold) == "0.5"
+              && !cl.wasPresent(mode) && cl.value(mode, "fast") == "fast";
+
+    // Unknown options, as given by optionId:
+    ok = ok && !cl.wasPresent(-1) && cl.rawValue(-1).empty() && cl.value(-1, 7) == 7 && !cl.wasPresent(3) && cl.value(1000, 7) == 7;
+    {
+        CmdLineArgs::ScopedOverride tuning(cl);
+        tuning.set(batch, 64).set(mode, "exact").set(-1, "3");
+        ok = ok && !cl.wasPresent(-1) && cl.rawValue(-1).empty() && cl.value(-1, 7) == 7;
+        ok = ok && cl.value(batch, 0) == 64 && cl.value(threshold, 0.0) == 0.5 && cl.wasPresent(mode) && cl.rawValue(mode) == "exact"
+              && cl.value(mode, "fast") == "exact";
+        {
+            CmdLineArgs::ScopedOverride inner(cl);
+            inner.set(batch, 128);
+            ok = ok && cl.value(batch, 0) == 128;
+
+            // Other threads do not see the overrides:
+            int other_batch = 0;
+            thread other([&]{ other_batch = cl.value(batch, 0); });
+            other.join();
+            ok = ok && other_batch == 32;
+        }
+        ok = ok && cl.value(batch, 0) == 64;
+    }
+    ok = ok && cl.value(batch, 0) == 32 && !cl.wasPresent(mode);
+
+    if( !ok ) {
+        cout << "Test " << test_no << ": Overrides failure.\n";
+        ++failures;
+    }
+}